@@ -0,0 +1,245 @@
+#include "ApiServer.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "Format.h"
+#include "PngEncoder.h"
+
+namespace {
+constexpr auto CONTENT_TYPE_JSON = "application/json";
+constexpr size_t SAMPLE_JSON_SIZE_MAX = 112;
+
+// Only plain decimal digits, so "-1" or "abc" is an error instead of a wrapped value or 0.
+bool parseUnsigned(const String &text, uint32_t &value) {
+	if (!isdigit(static_cast<unsigned char>(*text.c_str()))) return false;
+	char *end = nullptr;
+	errno = 0;
+	const auto parsed = strtoul(text.c_str(), &end, 10);
+	if (*end != '\0' || errno == ERANGE || parsed > std::numeric_limits<uint32_t>::max()) {
+		return false;
+	}
+	value = parsed;
+	return true;
+}
+}  // namespace
+
+void ApiServer::enableScreenshot(DamageLog &damage, int32_t width, int32_t height,
+								 ScreenReader reader) {
+	_damage = &damage;
+	_screen = Rect{0, 0, width, height};
+	_screen_reader = std::move(reader);
+}
+
+bool ApiServer::begin(void) {
+	_server.on("/api/current", HTTP_GET, [this]() { handleCurrent(); });
+	_server.on("/api/history", HTTP_GET, [this]() { handleHistory(); });
+	if (_damage != nullptr) {
+		_server.on("/api/screenshot", HTTP_GET, [this]() { handleScreenshot(); });
+	}
+	if (_power != nullptr) {
+		_server.on("/api/power", HTTP_GET, [this]() { handlePower(); });
+	}
+	_server.onNotFound(
+		[this]() { _server.send(404, CONTENT_TYPE_JSON, "{\"error\":\"not found\"}"); });
+	_server.begin();
+
+	return xTaskCreatePinnedToCore(task, "apiServer", 8192, this, 1, nullptr, 0) == pdPASS;
+}
+
+void ApiServer::publish(const Sample &sample) {
+	char buf[SAMPLE_JSON_SIZE_MAX];
+	auto len = formatSample(sample, "", buf, sizeof(buf));
+
+	Payload payload = std::make_shared<const std::string>(buf, len);
+	portENTER_CRITICAL(&_mux);
+	_current.swap(payload);
+	portEXIT_CRITICAL(&_mux);
+	// the previous payload is freed here, or by the last client still sending it
+}
+
+void ApiServer::task(void *pvParameters) {
+	auto self = static_cast<ApiServer *>(pvParameters);
+	while (true) {
+		self->_server.handleClient();
+		delay(2);
+	}
+}
+
+size_t ApiServer::formatSample(const Sample &sample, const char *prefix, char *buf, size_t size) {
+	// failed reads are null rather than zeros that look like readings
+	size_t len = appendf(buf, size, 0, "%s{\"timestamp\":%ld,", prefix,
+						 static_cast<long>(sample.timestamp));
+	if (sample.climate_valid) {
+		len = appendf(buf, size, len, "\"temperature\":%.1f,\"humidity\":%u,",
+					  sample.temperature, sample.humidity);
+	} else {
+		len = appendf(buf, size, len, "\"temperature\":null,\"humidity\":null,");
+	}
+	if (sample.co2 > 0) {
+		len = appendf(buf, size, len, "\"co2\":%u,", sample.co2);
+	} else {
+		len = appendf(buf, size, len, "\"co2\":null,");
+	}
+	return appendf(buf, size, len, "\"battery\":%u}", sample.battery);
+}
+
+ApiServer::Payload ApiServer::current(void) {
+	portENTER_CRITICAL(&_mux);
+	Payload payload = _current;
+	portEXIT_CRITICAL(&_mux);
+	return payload;
+}
+
+void ApiServer::handleCurrent(void) {
+	auto payload = current();
+	if (!payload) {
+		_server.send(503, CONTENT_TYPE_JSON, "{\"error\":\"no data yet\"}");
+		return;
+	}
+	_server.send_P(200, CONTENT_TYPE_JSON, payload->data(), payload->size());
+}
+
+void ApiServer::handleHistory(void) {
+	constexpr size_t SAMPLES_PER_READ = 16;
+	constexpr size_t CHUNK_SIZE = 1024;
+
+	uint32_t from = 0;
+	uint32_t to = std::numeric_limits<uint32_t>::max();
+	uint32_t step = 0;
+	if ((_server.hasArg("from") && !parseUnsigned(_server.arg("from"), from)) ||
+		(_server.hasArg("to") && !parseUnsigned(_server.arg("to"), to)) ||
+		(_server.hasArg("step") && !parseUnsigned(_server.arg("step"), step)) || from > to) {
+		_server.send(400, CONTENT_TYPE_JSON, "{\"error\":\"invalid query\"}");
+		return;
+	}
+
+	// Chunked transfer: the response is never held in RAM as a whole.
+	_server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+	_server.send(200, CONTENT_TYPE_JSON, "");
+
+	std::array<Sample, SAMPLES_PER_READ> samples;
+	std::array<char, CHUNK_SIZE> chunk;
+	size_t len = 0;
+	chunk[len++] = '[';
+
+	const char *separator = "";
+	bool first = true;
+	int64_t last_timestamp = 0;  // 64 bits: any step fits without overflow
+	uint32_t seq = 0;
+	size_t n;
+	while ((n = _history.read(seq, samples.data(), samples.size())) > 0) {
+		for (size_t i = 0; i < n; i++) {
+			const auto &sample = samples[i];
+			const int64_t timestamp = sample.timestamp;
+			if (timestamp < from || timestamp > to) continue;
+			if (!first && timestamp - last_timestamp < step) continue;
+			first = false;
+			last_timestamp = timestamp;
+
+			if (chunk.size() - len < SAMPLE_JSON_SIZE_MAX) {
+				_server.sendContent(chunk.data(), len);
+				len = 0;
+			}
+			len += formatSample(sample, separator, chunk.data() + len, chunk.size() - len);
+			separator = ",";
+		}
+		// don't walk the rest of the history for a client that has gone away
+		if (!_server.client().connected()) return;
+	}
+
+	chunk[len++] = ']';
+	_server.sendContent(chunk.data(), len);
+	_server.sendContent("");  // terminating chunk
+}
+
+void ApiServer::handleScreenshot(void) {
+	const bool pgm = _server.arg("format") == "pgm";
+
+	// Read the frame number first: anything drawn while capturing shows up in the next delta.
+	const auto frame = _damage->frame();
+	Rect rect = _screen;
+	if (_server.hasArg("since")) {
+		uint32_t since_frame;
+		if (!parseUnsigned(_server.arg("since"), since_frame)) {
+			_server.send(400, CONTENT_TYPE_JSON, "{\"error\":\"invalid query\"}");
+			return;
+		}
+		Rect damage;
+		if (_damage->since(since_frame, damage)) {
+			if (damage.empty()) {
+				_server.sendHeader("X-Frame", String(frame));
+				_server.send(304);
+				return;
+			}
+			rect = damage;
+		}
+	}
+
+	char rect_str[48];
+	snprintf(rect_str, sizeof(rect_str), "%d,%d,%d,%d", static_cast<int>(rect.x),
+			 static_cast<int>(rect.y), static_cast<int>(rect.w), static_cast<int>(rect.h));
+	_server.sendHeader("X-Frame", String(frame));
+	_server.sendHeader("X-Rect", rect_str);
+	_server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+	_server.send(200, pgm ? "image/x-portable-graymap" : "image/png", "");
+
+	// Captured row by row, so the render loop only ever waits for a single row.
+	std::vector<uint8_t> gray(rect.w);
+	auto sendBytes = [this](const uint8_t *data, size_t len) {
+		_server.sendContent(reinterpret_cast<const char *>(data), len);
+	};
+
+	if (pgm) {
+		char header[32];
+		auto len = snprintf(header, sizeof(header), "P5\n%d %d\n15\n", static_cast<int>(rect.w),
+							static_cast<int>(rect.h));
+		_server.sendContent(header, len);
+		for (int32_t y = rect.y; y < rect.y + rect.h; y++) {
+			_screen_reader(rect.x, y, rect.w, gray.data());
+			sendBytes(gray.data(), gray.size());
+			if (!_server.client().connected()) return;
+		}
+	} else {
+		PngEncoder png(sendBytes);
+		png.begin(rect.w, rect.h);
+		for (int32_t y = rect.y; y < rect.y + rect.h; y++) {
+			_screen_reader(rect.x, y, rect.w, gray.data());
+			png.writeRow(gray.data());
+			if (!_server.client().connected()) return;
+		}
+		png.end();
+	}
+	_server.sendContent("");  // terminating chunk
+}
+
+void ApiServer::handlePower(void) {
+	const auto report = _power->report();
+	if (std::isnan(report.voltage)) {
+		_server.send(503, CONTENT_TYPE_JSON, "{\"error\":\"no data yet\"}");
+		return;
+	}
+
+	char buf[384];
+	size_t len = appendf(
+		buf, sizeof(buf), 0,
+		"{\"voltage\":%.0f,\"state_of_charge\":%.3f,\"current\":%.1f,\"charging\":%s,",
+		report.voltage, report.state_of_charge, report.current, report.charging ? "true" : "false");
+	if (std::isnan(report.hours_remaining)) {
+		len = appendf(buf, sizeof(buf), len, "\"hours_remaining\":null,");
+	} else {
+		len = appendf(buf, sizeof(buf), len, "\"hours_remaining\":%.1f,", report.hours_remaining);
+	}
+	len = appendf(buf, sizeof(buf), len, "\"breakdown\":{");
+	for (size_t i = 0; i < PowerModel::ACTIVITY_COUNT; i++) {
+		len = appendf(buf, sizeof(buf), len, "%s\"%s\":%.2f", i == 0 ? "" : ",",
+					  PowerModel::activityName(static_cast<PowerModel::Activity>(i)),
+					  report.breakdown[i]);
+	}
+	appendf(buf, sizeof(buf), len, "}}");
+	_server.send(200, CONTENT_TYPE_JSON, buf);
+}
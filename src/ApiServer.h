@@ -0,0 +1,62 @@
+#pragma once
+
+#include <WebServer.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "DamageLog.h"
+#include "PowerModel.h"
+#include "Sample.h"
+#include "SampleHistory.h"
+
+// Read-only HTTP API for other systems in the building.
+//   GET /api/current                         latest sample
+//   GET /api/history?from=&to=&step=         samples in [from, to] (epoch seconds), at most
+//                                            one every step seconds, streamed in chunks
+//   GET /api/screenshot?format=png|pgm&since=  current frame, or only the part of it redrawn
+//                                            after frame `since` (see the X-Frame header)
+//   GET /api/power                           battery estimate and modelled current per activity
+class ApiServer {
+public:
+	// Reads w pixels of row y starting at x as 4-bit gray levels, one byte per pixel.
+	using ScreenReader = std::function<void(int32_t x, int32_t y, int32_t w, uint8_t *gray4)>;
+
+	ApiServer(SampleHistory &history, uint16_t port = 80) : _history(history), _server(port) {}
+
+	// Must be called before begin() for /api/screenshot to be served.
+	void enableScreenshot(DamageLog &damage, int32_t width, int32_t height, ScreenReader reader);
+
+	// Must be called before begin() for /api/power to be served.
+	void enablePower(PowerModel &power) { _power = &power; }
+
+	bool begin(void);  // returns true, if the server task could be started
+
+	// Serializes the sample once. Every /api/current request until the next publish() is
+	// answered straight from that buffer, so clients never wait for (or delay) the render loop.
+	void publish(const Sample &sample);
+
+private:
+	using Payload = std::shared_ptr<const std::string>;
+
+	SampleHistory &_history;
+	WebServer _server;
+	Payload _current;
+	portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+	DamageLog *_damage = nullptr;
+	Rect _screen{0, 0, 0, 0};
+	ScreenReader _screen_reader;
+
+	PowerModel *_power = nullptr;
+
+	static void task(void *pvParameters);
+	static size_t formatSample(const Sample &sample, const char *prefix, char *buf, size_t size);
+
+	Payload current(void);
+	void handleCurrent(void);
+	void handleHistory(void);
+	void handleScreenshot(void);
+	void handlePower(void);
+};
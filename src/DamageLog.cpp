@@ -0,0 +1,42 @@
+#include "DamageLog.h"
+
+#include <algorithm>
+
+uint32_t DamageLog::add(const Rect &rect) {
+	portENTER_CRITICAL(&_mux);
+	auto frame = ++_frame;
+	_rects[frame % SIZE] = rect;
+	portEXIT_CRITICAL(&_mux);
+	return frame;
+}
+
+uint32_t DamageLog::frame(void) {
+	portENTER_CRITICAL(&_mux);
+	auto frame = _frame;
+	portEXIT_CRITICAL(&_mux);
+	return frame;
+}
+
+bool DamageLog::since(uint32_t frame, Rect &out) {
+	out = Rect{0, 0, 0, 0};
+
+	portENTER_CRITICAL(&_mux);
+	// a frame from the future was seen before a reboot reset the counter
+	if (frame > _frame || _frame - frame > SIZE) {
+		portEXIT_CRITICAL(&_mux);
+		return false;
+	}
+	int32_t x0 = INT32_MAX, y0 = INT32_MAX, x1 = INT32_MIN, y1 = INT32_MIN;
+	for (auto f = frame; f < _frame; f++) {
+		const auto &rect = _rects[(f + 1) % SIZE];
+		if (rect.empty()) continue;
+		x0 = std::min(x0, rect.x);
+		y0 = std::min(y0, rect.y);
+		x1 = std::max(x1, rect.x + rect.w);
+		y1 = std::max(y1, rect.y + rect.h);
+	}
+	portEXIT_CRITICAL(&_mux);
+
+	if (x0 < x1 && y0 < y1) out = Rect{x0, y0, x1 - x0, y1 - y0};
+	return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <array>
+
+#include "Rect.h"
+
+// Remembers which part of the screen each of the last few frames redrew.
+class DamageLog {
+public:
+	uint32_t add(const Rect &rect);  // records a new frame and returns its number
+	uint32_t frame(void);            // number of the latest frame
+
+	// Bounding box of everything drawn after the given frame (empty if nothing was).
+	// Returns false, if the log no longer reaches back that far or the frame is not known yet.
+	bool since(uint32_t frame, Rect &out);
+
+private:
+	static constexpr size_t SIZE = 32;
+
+	std::array<Rect, SIZE> _rects;
+	uint32_t _frame = 0;
+	portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+};
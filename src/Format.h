@@ -0,0 +1,21 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+
+// snprintf at buf + len that never moves len past the end of buf, so calls can be chained
+// without checking for truncation in between. Returns the new length.
+inline size_t appendf(char *buf, size_t size, size_t len, const char *format, ...)
+	__attribute__((format(printf, 4, 5)));
+
+inline size_t appendf(char *buf, size_t size, size_t len, const char *format, ...) {
+	if (len + 1 >= size) return len;
+	va_list args;
+	va_start(args, format);
+	const int n = vsnprintf(buf + len, size - len, format, args);
+	va_end(args);
+	if (n < 0) return len;
+	return std::min(len + n, size - 1);
+}
@@ -0,0 +1,150 @@
+#include "FrameClient.h"
+
+#include <HTTPClient.h>
+
+#include <algorithm>
+
+namespace {
+constexpr uint8_t FRAME_VERSION = 1;
+
+inline uint16_t getLE16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+Rect unite(const Rect &a, const Rect &b) {
+	if (a.empty()) return b;
+	const int32_t x0 = std::min(a.x, b.x);
+	const int32_t y0 = std::min(a.y, b.y);
+	const int32_t x1 = std::max(a.x + a.w, b.x + b.w);
+	const int32_t y1 = std::max(a.y + a.h, b.y + b.h);
+	return Rect{x0, y0, x1 - x0, y1 - y0};
+}
+
+bool readExact(Stream &stream, uint8_t *buf, size_t len) {
+	return stream.readBytes(buf, len) == len;
+}
+}  // namespace
+
+FrameClient::Result FrameClient::update(const Sink &sink) {
+	constexpr uint16_t HTTP_TIMEOUT = 3000;
+
+	if (!WiFi.isConnected()) return Result::Failed;
+
+	WiFiClient client;
+	HTTPClient http;
+	if (!http.begin(client, _url)) {
+		Serial.printf("[HTTP] Failed to parse url\n");
+		return Result::Failed;
+	}
+	http.setTimeout(HTTP_TIMEOUT);
+	const char *headers[] = {"ETag"};
+	http.collectHeaders(headers, 1);
+	if (_etag.length() > 0) http.addHeader("If-None-Match", _etag);
+
+	int httpCode = http.GET();
+	if (httpCode == HTTP_CODE_NOT_MODIFIED) {
+		http.end();
+		return Result::NotModified;
+	}
+	if (httpCode != HTTP_CODE_OK) {
+		Serial.printf("[HTTP] GET... failed, error: %s\n", http.errorToString(httpCode).c_str());
+		http.end();
+		return Result::Failed;
+	}
+
+	auto result = decode(client, sink);
+	// a frame drawn only in part matches nothing the server knows
+	_etag = result == Result::Updated ? http.header("ETag") : String("");
+	http.end();
+	return result;
+}
+
+FrameClient::Result FrameClient::decode(Stream &stream, const Sink &sink) {
+	uint8_t header[9];
+	if (!readExact(stream, header, sizeof(header)) || memcmp(header, "M5TD", 4) != 0 ||
+		header[4] != FRAME_VERSION) {
+		Serial.printf("[FRAME] Invalid header\n");
+		return Result::Failed;
+	}
+	const int32_t tile_size = getLE16(header + 5);
+	const uint16_t count = getLE16(header + 7);
+	if (tile_size == 0 || tile_size > TILE_SIZE_MAX) {
+		Serial.printf("[FRAME] Unsupported tile size: %d\n", static_cast<int>(tile_size));
+		return Result::Failed;
+	}
+
+	const int32_t tiles_per_row = (_width + tile_size - 1) / tile_size;
+	const int32_t tiles = tiles_per_row * ((_height + tile_size - 1) / tile_size);
+
+	const bool together = count > SEPARATE_TILES_MAX;
+	Rect written{0, 0, 0, 0};
+	if (together) sink.begin();
+
+	auto result = Result::Updated;
+	for (uint16_t i = 0; i < count; i++) {
+		uint8_t tile_header[4];
+		if (!readExact(stream, tile_header, sizeof(tile_header))) {
+			result = Result::Failed;
+			break;
+		}
+		const uint16_t index = getLE16(tile_header);
+		const uint16_t len = getLE16(tile_header + 2);
+		// at worst one byte per pixel
+		if (index >= tiles || len > tile_size * tile_size) {
+			Serial.printf("[FRAME] Invalid tile: %u\n", index);
+			result = Result::Failed;
+			break;
+		}
+
+		_payload.resize(len);
+		if (!readExact(stream, _payload.data(), len)) {
+			result = Result::Failed;
+			break;
+		}
+
+		const int32_t x = index % tiles_per_row * tile_size;
+		const int32_t y = index / tiles_per_row * tile_size;
+		const Rect tile{x, y, std::min(tile_size, _width - x), std::min(tile_size, _height - y)};
+
+		if (!together) sink.begin();
+		const bool ok = decodeTile(_payload, tile, sink);
+		if (together) {
+			written = unite(written, tile);
+		} else {
+			sink.end(tile);
+		}
+		if (!ok) {
+			Serial.printf("[FRAME] Corrupt tile: %u\n", index);
+			result = Result::Failed;
+			break;
+		}
+	}
+
+	// whatever made it to the screen is refreshed, even if the frame is incomplete
+	if (together) sink.end(written);
+	return result;
+}
+
+bool FrameClient::decodeTile(const std::vector<uint8_t> &payload, const Rect &tile,
+							 const Sink &sink) {
+	const int32_t area = tile.w * tile.h;
+	int32_t pos = 0;
+
+	for (size_t i = 0; i < payload.size(); i++) {
+		const uint8_t gray4 = payload[i] & 0x0f;
+		int32_t run = (payload[i] >> 4) + 1;
+		if (run == 16) {
+			if (++i == payload.size()) return false;
+			run += payload[i];
+		}
+		if (pos + run > area) return false;
+
+		// runs may wrap to the next row of the tile
+		while (run > 0) {
+			const int32_t x = pos % tile.w;
+			const int32_t w = std::min(run, tile.w - x);
+			sink.write_run(tile.x + x, tile.y + pos / tile.w, w, gray4);
+			pos += w;
+			run -= w;
+		}
+	}
+	return pos == area;
+}
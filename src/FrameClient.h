@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <functional>
+#include <vector>
+
+#include "DamageLog.h"
+
+// Pulls frames rendered by a server on the local network instead of drawing them on the device.
+//
+// The device sends the ETag of the frame it shows as If-None-Match. The server answers 304 if
+// nothing changed, or 200 with only the tiles that differ from that frame (all tiles if it does
+// not know the ETag) and the ETag of the new frame. The body must not use chunked encoding.
+// All integers are little-endian.
+//   "M5TD", uint8 version (1), uint16 tile size, uint16 tile count
+//   per tile: uint16 index (row-major), uint16 payload length, payload
+// The payload is the tile's pixels in row-major order, run-length encoded one run per byte:
+// low nibble is the gray level (0: black, 15: white), high nibble n is a run of n + 1 pixels.
+// n = 15 is followed by a byte m for a run of 16 + m pixels.
+// tools/render_server.py is a stand-in server that speaks this format.
+class FrameClient {
+public:
+	// A few changed tiles are refreshed one by one. Larger updates, like the full frame after
+	// invalidate(), are written in one go and refreshed together.
+	struct Sink {
+		std::function<void(void)> begin;
+		std::function<void(int32_t x, int32_t y, int32_t w, uint8_t gray4)> write_run;
+		std::function<void(const Rect &area)> end;  // area: bounding box of what was written
+	};
+
+	enum class Result { Updated, NotModified, Failed };
+
+	FrameClient(const char *url, int32_t width, int32_t height)
+		: _url(url), _width(width), _height(height) {}
+
+	Result update(const Sink &sink);
+
+	// The screen was drawn over by something else; the next update fetches the whole frame.
+	void invalidate(void) { _etag = ""; }
+
+private:
+	static constexpr uint16_t TILE_SIZE_MAX = 120;
+	static constexpr uint16_t SEPARATE_TILES_MAX = 4;
+
+	const char *_url;
+	int32_t _width;
+	int32_t _height;
+	String _etag;
+	std::vector<uint8_t> _payload;
+
+	Result decode(Stream &stream, const Sink &sink);
+	static bool decodeTile(const std::vector<uint8_t> &payload, const Rect &tile, const Sink &sink);
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "Rect.h"
+#include "TouchInput.h"
+
+// Which view is shown and how touch moves between them. Nothing here draws, so it also builds
+// for the host tests.
+
+// What the left panel shows. The right panel (date and status) is the same in every view, so
+// switching views only redraws the left panel.
+enum class View : uint8_t { Live, History, DetailCo2, DetailTemperature, DetailHumidity };
+
+enum class Metric : uint8_t { Co2, Temperature, Humidity };
+
+// Screen layout, shared by the full redraw in main.cpp and the partial redraws of the views
+constexpr int32_t SCREEN_WIDTH = 960;
+constexpr int32_t SCREEN_HEIGHT = 540;
+constexpr int32_t MARGIN_X = 45;
+constexpr int32_t MARGIN_Y = 30;
+constexpr int32_t DIVIDER_X = SCREEN_WIDTH * 57 / 100;
+constexpr int32_t DIVIDER_WIDTH = 3;
+
+constexpr Rect LEFT_PANEL{0, 0, DIVIDER_X, SCREEN_HEIGHT};  // everything left of the divider
+constexpr Rect VIEW_AREA{MARGIN_X, MARGIN_Y, 480, SCREEN_HEIGHT - 2 * MARGIN_Y};
+constexpr int32_t HISTORY_SLOT_HEIGHT = VIEW_AREA.h / 3;
+
+struct MetricInfo {
+	const char *name;
+	const char *format;
+	float span_min;  // smallest value range a chart is scaled to
+};
+
+constexpr std::array<MetricInfo, 3> METRICS{{
+	{"CO2", "%.0fppm", 200.0},
+	{"TEMP", "%.1f℃", 2.0},
+	{"HUM", "%.0f%%", 10.0},
+}};
+
+inline const MetricInfo &metricInfo(Metric metric) {
+	return METRICS[static_cast<size_t>(metric)];
+}
+
+inline View detailView(Metric metric) {
+	return static_cast<View>(static_cast<uint8_t>(View::DetailCo2) + static_cast<uint8_t>(metric));
+}
+
+inline Metric detailMetric(View view) {
+	return static_cast<Metric>(static_cast<uint8_t>(view) - static_cast<uint8_t>(View::DetailCo2));
+}
+
+// Live view:   tap a reading for its detail page, swipe left for the history charts
+// History:     tap a chart for its detail page, swipe right for the live view
+// Detail page: swipe left / right for the next / previous metric, tap for the live view
+// live_row is the text row of the live view the gesture started on (0: clock).
+inline View navigate(View view, const GestureEvent &event, int32_t live_row) {
+	constexpr uint8_t METRIC_COUNT = METRICS.size();
+
+	if (event.gesture == Gesture::Tap && event.x >= LEFT_PANEL.w) return view;
+
+	switch (view) {
+		case View::Live:
+			if (event.gesture == Gesture::SwipeLeft) return View::History;
+			if (event.gesture == Gesture::Tap && live_row >= 1 && live_row <= METRIC_COUNT) {
+				return detailView(static_cast<Metric>(live_row - 1));
+			}
+			break;
+		case View::History:
+			if (event.gesture == Gesture::SwipeRight) return View::Live;
+			if (event.gesture == Gesture::Tap && event.y >= VIEW_AREA.y &&
+				event.y < VIEW_AREA.y + VIEW_AREA.h) {
+				const int32_t slot = (event.y - VIEW_AREA.y) / HISTORY_SLOT_HEIGHT;
+				return detailView(static_cast<Metric>(slot));
+			}
+			break;
+		default: {
+			const uint8_t metric = static_cast<uint8_t>(detailMetric(view));
+			if (event.gesture == Gesture::SwipeLeft) {
+				return detailView(static_cast<Metric>((metric + 1) % METRIC_COUNT));
+			}
+			if (event.gesture == Gesture::SwipeRight) {
+				return detailView(static_cast<Metric>((metric + METRIC_COUNT - 1) % METRIC_COUNT));
+			}
+			if (event.gesture == Gesture::Tap) return View::Live;
+			break;
+		}
+	}
+	return view;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+namespace OtaInfo
+{
+  // required by ArduinoOTA (espota --auth) and by HTTP uploads (user "ota")
+  constexpr auto PASSWORD = "YOUR_OTA_PASSWORD";
+} // namespace OtaInfo
\ No newline at end of file
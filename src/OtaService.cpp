@@ -0,0 +1,329 @@
+#include "OtaService.h"
+
+#include <ArduinoOTA.h>
+#include <Update.h>
+
+#if __has_include(<esp32/rom/miniz.h>)
+#include <esp32/rom/miniz.h>
+#else
+#include <rom/miniz.h>
+#endif
+
+#include <algorithm>
+
+namespace {
+constexpr auto CONTENT_TYPE_JSON = "application/json";
+constexpr auto HTTP_USER = "ota";
+
+// gzip header flags (RFC 1952, 2.3.1)
+constexpr uint8_t GZIP_FHCRC = 0x02;
+constexpr uint8_t GZIP_FEXTRA = 0x04;
+constexpr uint8_t GZIP_FNAME = 0x08;
+constexpr uint8_t GZIP_FCOMMENT = 0x10;
+}  // namespace
+
+// Deflate state lives in PSRAM: 32 KB of output window plus the decompressor itself.
+struct OtaService::Inflater {
+	tinfl_decompressor decompressor;
+	uint8_t dict[TINFL_LZ_DICT_SIZE];
+	size_t dict_ofs;
+};
+
+bool OtaService::begin(SemaphoreHandle_t render_mutex) {
+	_render_mutex = render_mutex;
+
+	ArduinoOTA
+		.onStart([this]() {
+			String type;
+			if (ArduinoOTA.getCommand() == U_FLASH)
+				type = "sketch";
+			else  // U_SPIFFS
+				type = "filesystem";
+
+			// NOTE: if updating SPIFFS this would be the place to unmount SPIFFS using SPIFFS.end()
+			Serial.println("Start updating " + type);
+			pauseRendering();
+			startTransfer(0);
+			_written = 0;
+		})
+		.onEnd([this]() {
+			Serial.println("\nEnd");
+			resumeRendering();
+		})
+		.onProgress([this](unsigned int progress, unsigned int total) {
+			_written = progress;
+			reportProgress(progress, total);
+		})
+		.onError([this](ota_error_t error) {
+			Serial.printf("Error[%u]: ", error);
+			if (error == OTA_AUTH_ERROR)
+				Serial.println("Auth Failed");
+			else if (error == OTA_BEGIN_ERROR)
+				Serial.println("Begin Failed");
+			else if (error == OTA_CONNECT_ERROR)
+				Serial.println("Connect Failed");
+			else if (error == OTA_RECEIVE_ERROR)
+				Serial.println("Receive Failed");
+			else if (error == OTA_END_ERROR)
+				Serial.println("End Failed");
+			resumeRendering();
+		});
+
+	ArduinoOTA.setPassword(_password);
+	ArduinoOTA.begin();
+
+	const char *headers[] = {"Authorization"};
+	_server.collectHeaders(headers, 1);
+	_server.on("/update", HTTP_GET, [this]() { handleStatus(); });
+	_server.on(
+		"/update", HTTP_POST, [this]() { handleUploadDone(); }, [this]() { handleUpload(); });
+	_server.begin();
+
+	return xTaskCreatePinnedToCore(task, "otaService", 8192, this, 1, nullptr, 0) == pdPASS;
+}
+
+void OtaService::task(void *pvParameters) {
+	auto self = static_cast<OtaService *>(pvParameters);
+	while (true) {
+		ArduinoOTA.handle();
+		self->_server.handleClient();
+		delay(10);
+	}
+}
+
+void OtaService::pauseRendering(void) {
+	if (_rendering_paused) return;
+	xSemaphoreTake(_render_mutex, portMAX_DELAY);
+	_rendering_paused = true;
+}
+
+void OtaService::resumeRendering(void) {
+	if (!_rendering_paused) return;
+	_rendering_paused = false;
+	xSemaphoreGive(_render_mutex);
+}
+
+void OtaService::startTransfer(uint32_t received) {
+	_start_ms = millis();
+	_start_received = received;
+	_flash_us = 0;
+}
+
+void OtaService::reportProgress(unsigned int progress, unsigned int total) {
+	if (total >= 100) {
+		Serial.printf("Progress: %u%%", progress / (total / 100));
+	} else {
+		Serial.printf("Progress: %u bytes", progress);
+	}
+
+	const uint32_t elapsed_ms = std::max<uint32_t>(millis() - _start_ms, 1);
+	// bytes per ms * 1000 / 1024 = KB/s
+	Serial.printf(" (transfer %.1f KB/s", (progress - _start_received) / 1.024f / elapsed_ms);
+	if (_flash_us > 0) {
+		Serial.printf(", flash %.1f KB/s", _written * (1000000.0f / 1024) / _flash_us);
+	}
+	Serial.print(")\r");
+}
+
+bool OtaService::startSession(void) {
+	endSession();
+	if (!Update.begin(UPDATE_SIZE_UNKNOWN, U_FLASH)) {
+		fail(500, "Begin Failed");
+		return false;
+	}
+
+	Serial.println("Start updating sketch");
+	_session = true;
+	_gzip = false;
+	_inflated = false;
+	_received = 0;
+	_written = 0;
+	return true;
+}
+
+void OtaService::endSession(void) {
+	if (_session && Update.isRunning()) Update.abort();
+	_session = false;
+	free(_inflater);
+	_inflater = nullptr;
+}
+
+void OtaService::fail(int code, const char *error) {
+	Serial.printf("Error: %s\n", error);
+	_upload_error_code = code;
+	_upload_error = error;
+	endSession();
+}
+
+bool OtaService::receive(const uint8_t *data, size_t len) {
+	const size_t chunk_len = len;
+
+	if (_received == 0 && len >= 2 && data[0] == 0x1f && data[1] == 0x8b) {
+		const auto header = gzipHeaderSize(data, len);
+		_inflater = static_cast<Inflater *>(ps_malloc(sizeof(Inflater)));
+		if (header == 0 || _inflater == nullptr) {
+			fail(500, header == 0 ? "Unsupported gzip header" : "Out of memory");
+			return false;
+		}
+		tinfl_init(&_inflater->decompressor);
+		_inflater->dict_ofs = 0;
+		_gzip = true;
+		data += header;
+		len -= header;
+	}
+
+	if (!(_gzip ? inflate(data, len) : writeFlash(data, len))) {
+		fail(500, _gzip && !Update.hasError() ? "Corrupt gzip stream" : "Write Failed");
+		return false;
+	}
+	_received += chunk_len;
+	reportProgress(_received, _total);
+	return true;
+}
+
+bool OtaService::inflate(const uint8_t *data, size_t len) {
+	while (!_inflated) {
+		size_t in_bytes = len;
+		size_t out_bytes = TINFL_LZ_DICT_SIZE - _inflater->dict_ofs;
+		auto status = tinfl_decompress(&_inflater->decompressor, data, &in_bytes, _inflater->dict,
+									   _inflater->dict + _inflater->dict_ofs, &out_bytes,
+									   TINFL_FLAG_HAS_MORE_INPUT);
+		data += in_bytes;
+		len -= in_bytes;
+
+		if (out_bytes > 0 && !writeFlash(_inflater->dict + _inflater->dict_ofs, out_bytes)) {
+			return false;
+		}
+		_inflater->dict_ofs = (_inflater->dict_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+		if (status < TINFL_STATUS_DONE) return false;
+		// the gzip trailer is not checked; Update verifies the image itself
+		if (status == TINFL_STATUS_DONE) _inflated = true;
+		if (status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) break;
+	}
+	return true;
+}
+
+bool OtaService::writeFlash(const uint8_t *data, size_t len) {
+	const auto start = micros();
+	const auto written = Update.write(const_cast<uint8_t *>(data), len);
+	_flash_us += micros() - start;
+	_written += written;
+	return written == len;
+}
+
+size_t OtaService::gzipHeaderSize(const uint8_t *data, size_t len) {
+	constexpr size_t FIXED_HEADER_SIZE = 10;
+	constexpr uint8_t METHOD_DEFLATE = 8;
+
+	if (len < FIXED_HEADER_SIZE || data[2] != METHOD_DEFLATE) return 0;
+	const uint8_t flags = data[3];
+	size_t pos = FIXED_HEADER_SIZE;
+
+	if (flags & GZIP_FEXTRA) {
+		if (pos + 2 > len) return 0;
+		pos += 2 + (data[pos] | (data[pos + 1] << 8));
+	}
+	for (auto flag : {GZIP_FNAME, GZIP_FCOMMENT}) {
+		if (!(flags & flag)) continue;
+		while (pos < len && data[pos] != '\0') pos++;
+		pos++;
+	}
+	if (flags & GZIP_FHCRC) pos += 2;
+
+	// the header has to come in the first chunk, which is always larger than any sane header
+	return pos <= len ? pos : 0;
+}
+
+// An empty password would let anyone on the network flash the device, so it locks HTTP out.
+bool OtaService::authenticate(void) {
+	return _password[0] != '\0' && _server.authenticate(HTTP_USER, _password);
+}
+
+void OtaService::handleStatus(void) {
+	if (!authenticate()) {
+		_server.requestAuthentication();
+		return;
+	}
+	char body[48];
+	snprintf(body, sizeof(body), "{\"received\":%u,\"active\":%s}", _received,
+			 _session ? "true" : "false");
+	_server.send(200, CONTENT_TYPE_JSON, body);
+}
+
+void OtaService::handleUpload(void) {
+	HTTPUpload &upload = _server.upload();
+
+	switch (upload.status) {
+		case UPLOAD_FILE_START: {
+			_upload_error = nullptr;
+			if (!authenticate()) {
+				// checked before startSession(), so a session in progress is left alone
+				_upload_error_code = 401;
+				_upload_error = "Unauthorized";
+				return;
+			}
+			const uint32_t offset = _server.arg("offset").toInt();
+			if (offset == 0) {
+				if (!startSession()) return;
+			} else if (!_session || offset != _received) {
+				_upload_error_code = 409;
+				_upload_error = "Offset does not match the bytes received";
+				return;
+			}
+			_total = _server.hasArg("size") ? _server.arg("size").toInt() : 0;
+			pauseRendering();
+			startTransfer(_received);
+			break;
+		}
+		case UPLOAD_FILE_WRITE:
+			if (_upload_error == nullptr && _session) {
+				receive(upload.buf, upload.currentSize);
+			}
+			break;
+		case UPLOAD_FILE_END:
+		case UPLOAD_FILE_ABORTED:
+			resumeRendering();
+			break;
+	}
+}
+
+void OtaService::handleUploadDone(void) {
+	char body[96];
+
+	// checked again, since a POST without a file never reaches handleUpload()
+	if (!authenticate()) {
+		_server.requestAuthentication();
+		return;
+	}
+	if (_upload_error != nullptr) {
+		snprintf(body, sizeof(body), "{\"error\":\"%s\",\"received\":%u}", _upload_error,
+				 _received);
+		_server.send(_upload_error_code, CONTENT_TYPE_JSON, body);
+		return;
+	}
+
+	const bool complete = _gzip ? _inflated : (_total == 0 || _received >= _total);
+	if (!complete) {
+		// keep the session open for the rest of the image
+		snprintf(body, sizeof(body), "{\"received\":%u,\"done\":false}", _received);
+		_server.send(202, CONTENT_TYPE_JSON, body);
+		return;
+	}
+
+	_session = false;
+	if (!Update.end(true)) {
+		fail(500, "End Failed");
+		snprintf(body, sizeof(body), "{\"error\":\"%s\"}", Update.errorString());
+		_server.send(500, CONTENT_TYPE_JSON, body);
+		return;
+	}
+	free(_inflater);
+	_inflater = nullptr;
+
+	Serial.println("\nEnd");
+	snprintf(body, sizeof(body), "{\"received\":%u,\"done\":true}", _received);
+	_server.send(200, CONTENT_TYPE_JSON, body);
+	delay(100);
+	ESP.restart();
+}
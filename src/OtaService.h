@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WebServer.h>
+
+// Firmware updates, served from a task of their own so that sessions start right away instead
+// of on the next render cycle. Rendering is paused while an image is being written.
+//   ArduinoOTA (espota)                          plain images
+//   POST :8080/update?offset=&size=              multipart upload of a plain or gzip image.
+//                                                An interrupted upload can be resumed by
+//                                                posting the rest with offset set to the
+//                                                bytes received so far.
+//   GET  :8080/update                            bytes received so far
+// Both need the password, espota through --auth and HTTP through basic auth as user "ota".
+class OtaService {
+public:
+	explicit OtaService(const char *password, uint16_t port = 8080)
+		: _password(password), _server(port) {}
+
+	bool begin(SemaphoreHandle_t render_mutex);  // returns true, if the task could be started
+
+private:
+	struct Inflater;
+
+	const char *_password;
+	WebServer _server;
+	SemaphoreHandle_t _render_mutex = nullptr;
+	bool _rendering_paused = false;
+
+	// throughput of the current connection
+	uint32_t _start_ms = 0;
+	uint32_t _start_received = 0;
+	uint32_t _flash_us = 0;
+	uint32_t _written = 0;
+
+	// HTTP upload, kept across connections until the image is complete
+	bool _session = false;
+	bool _gzip = false;
+	bool _inflated = false;
+	Inflater *_inflater = nullptr;
+	uint32_t _received = 0;  // bytes of the uploaded file, compressed if gzip
+	uint32_t _total = 0;
+	const char *_upload_error = nullptr;
+	int _upload_error_code = 0;
+
+	static void task(void *pvParameters);
+	static size_t gzipHeaderSize(const uint8_t *data, size_t len);
+
+	void pauseRendering(void);
+	void resumeRendering(void);
+	void startTransfer(uint32_t received);
+	void reportProgress(unsigned int progress, unsigned int total);
+
+	bool startSession(void);
+	void endSession(void);
+	void fail(int code, const char *error);
+	bool receive(const uint8_t *data, size_t len);
+	bool inflate(const uint8_t *data, size_t len);
+	bool writeFlash(const uint8_t *data, size_t len);
+
+	bool authenticate(void);
+	void handleStatus(void);
+	void handleUpload(void);
+	void handleUploadDone(void);
+};
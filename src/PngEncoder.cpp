@@ -0,0 +1,182 @@
+#include "PngEncoder.h"
+
+namespace {
+constexpr uint8_t PNG_SIGNATURE[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+constexpr uint8_t PNG_FILTER_UP = 2;
+constexpr uint_fast16_t MATCH_LEN_MIN = 3;
+constexpr uint_fast16_t MATCH_LEN_MAX = 258;
+constexpr uint32_t ADLER_MOD = 65521;
+
+// deflate length codes 257-285 (RFC 1951, 3.2.5)
+constexpr uint16_t LEN_BASE[] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+								 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t LEN_EXTRA[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+								 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+inline void putBE32(uint8_t *p, uint32_t v) {
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+}  // namespace
+
+void PngEncoder::begin(uint32_t width, uint32_t height) {
+	_width = width;
+	const size_t stride = (width + 1) / 2;
+	_row.assign(stride + 1, 0);
+	_prev.assign(stride, 0);
+	_bit_buf = 0;
+	_bit_cnt = 0;
+	_adler_a = 1;
+	_adler_b = 0;
+
+	_sink(PNG_SIGNATURE, sizeof(PNG_SIGNATURE));
+
+	uint8_t *ihdr = _chunk.data() + CHUNK_HEADER_SIZE;
+	putBE32(ihdr, width);
+	putBE32(ihdr + 4, height);
+	ihdr[8] = 4;   // bit depth
+	ihdr[9] = 0;   // grayscale
+	ihdr[10] = 0;  // deflate
+	ihdr[11] = 0;  // adaptive filtering
+	ihdr[12] = 0;  // no interlace
+	writeChunk("IHDR", 13);
+
+	_chunk_len = 0;
+	putByte(0x78);  // zlib header: deflate, 32K window
+	putByte(0x01);  // fastest compression, no dictionary
+	writeBits(1, 1);  // BFINAL: the whole image is a single block
+	writeBits(1, 2);  // BTYPE: fixed Huffman codes
+}
+
+void PngEncoder::writeRow(const uint8_t *gray4) {
+	const size_t stride = _prev.size();
+	_row[0] = PNG_FILTER_UP;
+	for (size_t i = 0; i < stride; i++) {
+		uint8_t packed = gray4[2 * i] << 4;
+		if (2 * i + 1 < _width) packed |= gray4[2 * i + 1] & 0x0f;
+		_row[i + 1] = packed - _prev[i];
+		_prev[i] = packed;
+	}
+
+	for (auto b : _row) {
+		_adler_a = (_adler_a + b) % ADLER_MOD;
+		_adler_b = (_adler_b + _adler_a) % ADLER_MOD;
+	}
+
+	// a literal followed by distance-1 matches for the rest of each run
+	for (size_t i = 0; i < _row.size();) {
+		const auto value = _row[i];
+		writeSymbol(value);
+		size_t run = 0;
+		while (i + 1 + run < _row.size() && _row[i + 1 + run] == value) run++;
+		i += run + 1;
+
+		while (run >= MATCH_LEN_MIN) {
+			auto len = std::min<size_t>(run, MATCH_LEN_MAX);
+			// don't leave a tail too short to be a match when splitting long runs
+			if (run - len > 0 && run - len < MATCH_LEN_MIN) len -= MATCH_LEN_MIN;
+			writeMatch(len);
+			run -= len;
+		}
+		for (; run > 0; run--) writeSymbol(value);
+	}
+}
+
+void PngEncoder::end(void) {
+	writeSymbol(256);  // end of block
+	if (_bit_cnt > 0) putByte(_bit_buf);
+	_bit_buf = 0;
+	_bit_cnt = 0;
+
+	putByte(_adler_b >> 8);
+	putByte(_adler_b);
+	putByte(_adler_a >> 8);
+	putByte(_adler_a);
+	flushIdat();
+
+	writeChunk("IEND", 0);
+	_row.clear();
+	_row.shrink_to_fit();
+	_prev.clear();
+	_prev.shrink_to_fit();
+}
+
+void PngEncoder::putByte(uint8_t b) {
+	_chunk[CHUNK_HEADER_SIZE + _chunk_len++] = b;
+	if (_chunk_len == IDAT_SIZE) flushIdat();
+}
+
+void PngEncoder::writeBits(uint32_t bits, uint_fast8_t n) {
+	_bit_buf |= bits << _bit_cnt;
+	_bit_cnt += n;
+	while (_bit_cnt >= 8) {
+		putByte(_bit_buf);
+		_bit_buf >>= 8;
+		_bit_cnt -= 8;
+	}
+}
+
+void PngEncoder::writeSymbol(uint_fast16_t symbol) {
+	// fixed literal/length code (RFC 1951, 3.2.6)
+	uint32_t code;
+	uint_fast8_t n;
+	if (symbol < 144) {
+		code = 0x30 + symbol;
+		n = 8;
+	} else if (symbol < 256) {
+		code = 0x190 + symbol - 144;
+		n = 9;
+	} else if (symbol < 280) {
+		code = symbol - 256;
+		n = 7;
+	} else {
+		code = 0xc0 + symbol - 280;
+		n = 8;
+	}
+
+	// Huffman codes are packed starting from their most significant bit
+	uint32_t reversed = 0;
+	for (uint_fast8_t i = 0; i < n; i++) {
+		reversed = (reversed << 1) | ((code >> i) & 1);
+	}
+	writeBits(reversed, n);
+}
+
+void PngEncoder::writeMatch(uint_fast16_t len) {
+	uint_fast8_t idx = sizeof(LEN_BASE) / sizeof(LEN_BASE[0]) - 1;
+	while (LEN_BASE[idx] > len) idx--;
+	writeSymbol(257 + idx);
+	writeBits(len - LEN_BASE[idx], LEN_EXTRA[idx]);
+	writeBits(0, 5);  // distance code 0: distance 1
+}
+
+void PngEncoder::flushIdat(void) {
+	if (_chunk_len == 0) return;
+	writeChunk("IDAT", _chunk_len);
+	_chunk_len = 0;
+}
+
+void PngEncoder::writeChunk(const char *type, size_t len) {
+	putBE32(_chunk.data(), len);
+	memcpy(_chunk.data() + 4, type, 4);
+	const auto crc = crc32(0, _chunk.data() + 4, len + 4);
+	putBE32(_chunk.data() + CHUNK_HEADER_SIZE + len, crc);
+	_sink(_chunk.data(), CHUNK_HEADER_SIZE + len + 4);
+}
+
+uint32_t PngEncoder::crc32(uint32_t crc, const uint8_t *data, size_t len) {
+	// half-byte table: small enough to keep the encoder at a few KB
+	static constexpr uint32_t TABLE[16] = {
+		0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4,
+		0x4db26158, 0x5005713c, 0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+		0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c};
+
+	crc = ~crc;
+	for (size_t i = 0; i < len; i++) {
+		crc = TABLE[(crc ^ data[i]) & 0x0f] ^ (crc >> 4);
+		crc = TABLE[(crc ^ (data[i] >> 4)) & 0x0f] ^ (crc >> 4);
+	}
+	return ~crc;
+}
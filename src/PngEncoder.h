@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <array>
+#include <functional>
+#include <vector>
+
+// Streaming encoder for 4-bit grayscale PNG images.
+// Rows are Up-filtered and compressed with run-length matches only (fixed Huffman deflate,
+// as zlib's Z_RLE strategy does), so the whole state is two rows and one IDAT buffer
+// instead of a frame and a 32 KB deflate window.
+class PngEncoder {
+public:
+	using Sink = std::function<void(const uint8_t *data, size_t len)>;
+
+	explicit PngEncoder(Sink sink) : _sink(std::move(sink)) {}
+
+	void begin(uint32_t width, uint32_t height);
+	void writeRow(const uint8_t *gray4);  // one byte (0-15) per pixel
+	void end(void);
+
+private:
+	static constexpr size_t CHUNK_HEADER_SIZE = 8;
+	static constexpr size_t IDAT_SIZE = 1024;
+
+	Sink _sink;
+	uint32_t _width = 0;
+	std::vector<uint8_t> _row;   // filter type + filtered row
+	std::vector<uint8_t> _prev;  // previous row, packed but not filtered
+	std::array<uint8_t, CHUNK_HEADER_SIZE + IDAT_SIZE + 4> _chunk;
+	size_t _chunk_len = 0;
+	uint32_t _bit_buf = 0;
+	uint_fast8_t _bit_cnt = 0;
+	uint32_t _adler_a = 1;
+	uint32_t _adler_b = 0;
+
+	void putByte(uint8_t b);
+	void writeBits(uint32_t bits, uint_fast8_t n);
+	void writeSymbol(uint_fast16_t symbol);
+	void writeMatch(uint_fast16_t len);
+	void flushIdat(void);
+	void writeChunk(const char *type, size_t len);  // data already in _chunk
+
+	static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t len);
+};
@@ -0,0 +1,148 @@
+#include "PowerModel.h"
+
+#include <cmath>
+
+namespace {
+// Rough figures for the M5Paper; tune them against a USB power meter.
+constexpr float IDLE_MA = 25;
+constexpr float CPU_MA = 30;
+constexpr float WIFI_MA = 20;
+constexpr float HTTP_MA = 90;
+constexpr float EPD_QUALITY_MAS = 70;  // charge of one full-screen refresh
+constexpr float EPD_FAST_MAS = 30;
+constexpr float EPD_FASTEST_MAS = 12;
+constexpr float LED_MA = 1.5;
+
+// LiPo open-circuit voltage (mV) to state of charge
+struct CurvePoint {
+	float voltage;
+	float state_of_charge;
+};
+constexpr std::array<CurvePoint, 11> DISCHARGE_CURVE{{
+	{3300, 0.00},
+	{3500, 0.05},
+	{3600, 0.10},
+	{3700, 0.30},
+	{3750, 0.45},
+	{3800, 0.55},
+	{3850, 0.65},
+	{3900, 0.72},
+	{4000, 0.85},
+	{4100, 0.93},
+	{4200, 1.00},
+}};
+
+inline float rate(PowerModel::Activity activity) {
+	using Activity = PowerModel::Activity;
+	switch (activity) {
+		case Activity::Idle:
+			return IDLE_MA;
+		case Activity::Cpu:
+			return CPU_MA;
+		case Activity::WiFi:
+			return WIFI_MA;
+		case Activity::Http:
+			return HTTP_MA;
+		case Activity::Led:
+			return LED_MA;
+		default:
+			return 0;
+	}
+}
+}  // namespace
+
+const char *PowerModel::activityName(Activity activity) {
+	switch (activity) {
+		case Activity::Idle:
+			return "idle";
+		case Activity::Cpu:
+			return "cpu";
+		case Activity::WiFi:
+			return "wifi";
+		case Activity::Http:
+			return "http";
+		case Activity::EpdQuality:
+			return "epd_quality";
+		case Activity::EpdFast:
+			return "epd_fast";
+		case Activity::EpdFastest:
+			return "epd_fastest";
+		case Activity::Led:
+			return "led";
+	}
+	return "";
+}
+
+void PowerModel::addTime(Activity activity, uint32_t ms) {
+	portENTER_CRITICAL(&_mux);
+	_charge[static_cast<size_t>(activity)] += rate(activity) * ms / 1000;
+	portEXIT_CRITICAL(&_mux);
+}
+
+void PowerModel::addEpdRefresh(Activity mode, float area) {
+	float charge = 0;
+	if (mode == Activity::EpdQuality) {
+		charge = EPD_QUALITY_MAS;
+	} else if (mode == Activity::EpdFast) {
+		charge = EPD_FAST_MAS;
+	} else if (mode == Activity::EpdFastest) {
+		charge = EPD_FASTEST_MAS;
+	}
+
+	portENTER_CRITICAL(&_mux);
+	_charge[static_cast<size_t>(mode)] += charge * area;
+	portEXIT_CRITICAL(&_mux);
+}
+
+void PowerModel::endCycle(uint32_t cycle_ms, uint32_t battery_mv) {
+	if (cycle_ms == 0) return;
+	addTime(Activity::Idle, cycle_ms);
+	const float cycle_sec = cycle_ms / 1000.0f;
+
+	portENTER_CRITICAL(&_mux);
+	const float alpha = _first_cycle ? 1.0f : CURRENT_SMOOTHING;
+	float current = 0;
+	for (size_t i = 0; i < ACTIVITY_COUNT; i++) {
+		auto &average = _report.breakdown[i];
+		average += alpha * (_charge[i] / cycle_sec - average);
+		current += average;
+		_charge[i] = 0;
+	}
+	_report.current = current;
+
+	// the voltage sags under load, so a single reading says little
+	_report.voltage = _first_cycle ? battery_mv
+								   : _report.voltage +
+										 VOLTAGE_SMOOTHING * (battery_mv - _report.voltage);
+	_voltage_trend = _first_cycle
+						 ? battery_mv
+						 : _voltage_trend + TREND_SMOOTHING * (battery_mv - _voltage_trend);
+	// On USB power the voltage sits at the top of the curve or keeps rising towards it, and says
+	// nothing about how long the battery would last.
+	_report.charging = _report.voltage >= DISCHARGE_CURVE.back().voltage ||
+					   _report.voltage - _voltage_trend > CHARGE_RISE_MIN;
+	_report.state_of_charge = stateOfCharge(_report.voltage);
+	_report.hours_remaining =
+		_report.charging ? NAN : _report.state_of_charge * CAPACITY_MAH / current;
+	_first_cycle = false;
+	portEXIT_CRITICAL(&_mux);
+}
+
+PowerModel::Report PowerModel::report(void) {
+	portENTER_CRITICAL(&_mux);
+	Report report = _report;
+	portEXIT_CRITICAL(&_mux);
+	return report;
+}
+
+float PowerModel::stateOfCharge(float voltage) {
+	if (voltage <= DISCHARGE_CURVE.front().voltage) return 0;
+	if (voltage >= DISCHARGE_CURVE.back().voltage) return 1;
+
+	size_t i = 1;
+	while (DISCHARGE_CURVE[i].voltage < voltage) i++;
+	const auto &lo = DISCHARGE_CURVE[i - 1];
+	const auto &hi = DISCHARGE_CURVE[i];
+	return lo.state_of_charge + (hi.state_of_charge - lo.state_of_charge) *
+									(voltage - lo.voltage) / (hi.voltage - lo.voltage);
+}
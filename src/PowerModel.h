@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <array>
+#include <cmath>
+
+// Estimates where the battery charge goes and how long it will last.
+// Nothing on the board measures current, so each activity is charged at a fixed rate for the
+// time it was active (or per EPD refresh), and the runtime is the charge left according to the
+// smoothed battery voltage divided by the average modelled current.
+class PowerModel {
+public:
+	enum class Activity : uint8_t {
+		Idle,        // board, PSRAM and CPU idling; charged for the whole cycle
+		Cpu,         // extra while the render loop is busy
+		WiFi,        // extra while associated
+		Http,        // extra during requests
+		EpdQuality,  // per full-screen refresh
+		EpdFast,
+		EpdFastest,
+		Led,         // per lit LED
+	};
+	static constexpr size_t ACTIVITY_COUNT = 8;
+
+	struct Report {
+		float voltage;          // smoothed, mV
+		float state_of_charge;  // 0-1
+		float current;          // mA, average of the modelled total
+		float hours_remaining;  // NAN until the first cycle is done, and while charging
+		bool charging;
+		std::array<float, ACTIVITY_COUNT> breakdown;  // average mA per activity
+	};
+
+	static const char *activityName(Activity activity);
+
+	void addTime(Activity activity, uint32_t ms);
+	void addEpdRefresh(Activity mode, float area);  // area: refreshed fraction of the screen
+
+	// Closes a cycle of the render loop: turns what was recorded into average currents.
+	void endCycle(uint32_t cycle_ms, uint32_t battery_mv);
+
+	Report report(void);
+
+private:
+	static constexpr float CAPACITY_MAH = 1150;
+	static constexpr float CURRENT_SMOOTHING = 0.1;
+	static constexpr float VOLTAGE_SMOOTHING = 0.05;
+	static constexpr float TREND_SMOOTHING = 0.005;  // far slower, to tell a rising voltage
+	static constexpr float CHARGE_RISE_MIN = 10;     // mV above the trend
+
+	std::array<float, ACTIVITY_COUNT> _charge{};  // mAs in the current cycle
+	Report _report{NAN, NAN, NAN, NAN, false, {}};
+	float _voltage_trend = NAN;
+	bool _first_cycle = true;
+	portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+	static float stateOfCharge(float voltage);
+};
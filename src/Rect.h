@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+struct Rect {
+	int32_t x;
+	int32_t y;
+	int32_t w;
+	int32_t h;
+
+	bool empty(void) const { return w <= 0 || h <= 0; }
+};
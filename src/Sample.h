@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+
+// One reading of everything the dashboard knows about the room and itself.
+struct Sample {
+	time_t timestamp;
+	float temperature;
+	uint16_t co2;      // ppm
+	uint16_t battery;  // mV
+	uint8_t humidity;  // %
+	bool climate_valid;  // false: the SHT30 could not be read, temperature and humidity are 0
+};
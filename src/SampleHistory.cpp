@@ -0,0 +1,31 @@
+#include "SampleHistory.h"
+
+bool SampleHistory::begin(size_t capacity) {
+	_buf = static_cast<Sample *>(ps_malloc(capacity * sizeof(Sample)));
+	if (_buf == nullptr) return false;
+	_capacity = capacity;
+	return true;
+}
+
+void SampleHistory::push(const Sample &sample) {
+	if (_buf == nullptr) return;
+
+	portENTER_CRITICAL(&_mux);
+	_buf[_next % _capacity] = sample;
+	_next++;
+	portEXIT_CRITICAL(&_mux);
+}
+
+size_t SampleHistory::read(uint32_t &seq, Sample *out, size_t n) {
+	if (_buf == nullptr) return 0;
+
+	size_t cnt = 0;
+	portENTER_CRITICAL(&_mux);
+	const uint32_t oldest = _next > _capacity ? _next - _capacity : 0;
+	if (seq < oldest) seq = oldest;
+	for (; cnt < n && seq < _next; cnt++, seq++) {
+		out[cnt] = _buf[seq % _capacity];
+	}
+	portEXIT_CRITICAL(&_mux);
+	return cnt;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "Sample.h"
+
+// Fixed-size ring of samples kept in PSRAM.
+// Readers address samples by a sequence number that only ever grows, so they can iterate
+// through the history while the render loop keeps pushing new samples.
+class SampleHistory {
+public:
+	bool begin(size_t capacity);  // returns true, if the ring could be allocated
+
+	void push(const Sample &sample);
+
+	// Copies up to n samples starting at seq (clamped to the oldest sample still held) and
+	// advances seq past the last copied one. Returns the number of copied samples.
+	size_t read(uint32_t &seq, Sample *out, size_t n);
+
+private:
+	Sample *_buf = nullptr;
+	size_t _capacity = 0;
+	uint32_t _next = 0;
+	portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+};
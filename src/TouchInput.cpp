@@ -0,0 +1,56 @@
+#include "TouchInput.h"
+
+#include <cstdlib>
+
+void MockTouchSource::tap(int16_t x, int16_t y, uint32_t ms) {
+	push({true, x, y, ms});
+	push({false, x, y, ms + 50});
+}
+
+void MockTouchSource::swipe(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint32_t ms) {
+	constexpr int STEPS = 5;
+	constexpr uint32_t STEP_MS = 20;
+
+	for (int i = 0; i <= STEPS; i++) {
+		push({true, static_cast<int16_t>(x0 + (x1 - x0) * i / STEPS),
+			  static_cast<int16_t>(y0 + (y1 - y0) * i / STEPS), ms + i * STEP_MS});
+	}
+	push({false, x1, y1, ms + (STEPS + 1) * STEP_MS});
+}
+
+bool MockTouchSource::read(TouchPoint &point) {
+	if (_points.empty()) return false;
+	point = _points.front();
+	_points.pop_front();
+	return true;
+}
+
+GestureEvent GestureDetector::update(const TouchPoint &point) {
+	GestureEvent event{Gesture::None, _start.x, _start.y, point.ms};
+
+	if (point.down) {
+		if (!_down) _start = point;
+		_down = true;
+		_last = point;
+		return event;
+	}
+	if (!_down) return event;
+	_down = false;
+
+	// the controller does not report coordinates on release, so use the last ones
+	const int dx = _last.x - _start.x;
+	const int dy = _last.y - _start.y;
+	event.x = _start.x;
+	event.y = _start.y;
+
+	if (std::abs(dx) < TAP_SLOP && std::abs(dy) < TAP_SLOP) {
+		if (point.ms - _start.ms <= TAP_TIME_MAX) event.gesture = Gesture::Tap;
+	} else if (std::abs(dx) >= std::abs(dy)) {
+		if (std::abs(dx) >= SWIPE_DISTANCE_MIN) {
+			event.gesture = dx < 0 ? Gesture::SwipeLeft : Gesture::SwipeRight;
+		}
+	} else if (std::abs(dy) >= SWIPE_DISTANCE_MIN) {
+		event.gesture = dy < 0 ? Gesture::SwipeUp : Gesture::SwipeDown;
+	}
+	return event;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+struct TouchPoint {
+	bool down;
+	int16_t x;
+	int16_t y;
+	uint32_t ms;  // when the point was read
+};
+
+enum class Gesture : uint8_t { None, Tap, SwipeLeft, SwipeRight, SwipeUp, SwipeDown };
+
+struct GestureEvent {
+	Gesture gesture;
+	int16_t x;  // where the finger went down
+	int16_t y;
+	uint32_t ms;  // when the finger was lifted, i.e. when the gesture was recognized
+};
+
+// Anything that reports a single finger: the GT911 on the device, a script on the host.
+class TouchSource {
+public:
+	virtual ~TouchSource() = default;
+	virtual bool read(TouchPoint &point) = 0;  // returns true, if there was a new report
+};
+
+// Replays scripted points so that the input path can be exercised without a touch panel.
+class MockTouchSource : public TouchSource {
+public:
+	void push(const TouchPoint &point) { _points.push_back(point); }
+	void tap(int16_t x, int16_t y, uint32_t ms);
+	void swipe(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint32_t ms);
+
+	bool read(TouchPoint &point) override;
+
+private:
+	std::deque<TouchPoint> _points;
+};
+
+// The M5Paper's GT911, through M5EPD's GT911 class. Its flags and finger data describe the last
+// report that update() read (and acknowledged), so update() has to come first. The controller
+// interrupts once more when the finger is lifted, with no fingers in that report.
+// A template, so that the host tests can stand in for the driver.
+template <typename Driver>
+class GT911TouchSource : public TouchSource {
+public:
+	GT911TouchSource(Driver &driver, uint32_t (*clock)(void)) : _driver(driver), _clock(clock) {}
+
+	bool read(TouchPoint &point) override {
+		if (!_driver.avaliable()) return false;
+
+		_driver.update();
+		point.down = _driver.getFingerNum() > 0;
+		if (point.down) {
+			const auto finger = _driver.readFinger(0);
+			point.x = finger.x;
+			point.y = finger.y;
+		}
+		// a release keeps the coordinates of the last report with a finger
+		point.ms = _clock();
+		return true;
+	}
+
+private:
+	Driver &_driver;
+	uint32_t (*_clock)(void);
+};
+
+// Turns the reports of one finger into taps and swipes.
+class GestureDetector {
+public:
+	GestureEvent update(const TouchPoint &point);
+
+private:
+	static constexpr int16_t TAP_SLOP = 20;
+	static constexpr uint32_t TAP_TIME_MAX = 500;
+	static constexpr int16_t SWIPE_DISTANCE_MIN = 100;
+
+	bool _down = false;
+	TouchPoint _start{};
+	TouchPoint _last{};
+};
@@ -0,0 +1,228 @@
+#include "Uplink.h"
+
+#include <HTTPClient.h>
+#include <SPIFFS.h>
+
+#include <algorithm>
+
+#include "Format.h"
+
+namespace {
+constexpr auto BACKLOG_PATH = "/uplink.bin";
+constexpr auto BACKLOG_POS_PATH = "/uplink.pos";
+constexpr auto MEASUREMENT = "dashboard,host=m5paper";
+constexpr size_t LINE_SIZE_MAX = 128;
+constexpr time_t VALID_TIME_MIN = 1577836800;  // 2020/01/01, earlier means the clock was not set
+}  // namespace
+
+bool Uplink::begin(void) {
+	_ring = static_cast<Sample *>(ps_malloc(RING_CAPACITY * sizeof(Sample)));
+	_queue = xQueueCreate(QUEUE_LENGTH, sizeof(Sample));
+	if (_ring == nullptr || _queue == nullptr) return false;
+
+	_batch.resize(_batch_size);
+	_body.reserve(_batch_size * LINE_SIZE_MAX);
+
+	if (!SPIFFS.begin(true)) {
+		Serial.println("[UPLINK] Failed to mount SPIFFS, backlog is kept in PSRAM only");
+	} else if (SPIFFS.exists(BACKLOG_PATH)) {
+		// samples left over from before a reboot
+		File pos = SPIFFS.open(BACKLOG_POS_PATH, FILE_READ);
+		if (pos) {
+			pos.read(reinterpret_cast<uint8_t *>(&_backlog_pos), sizeof(_backlog_pos));
+			pos.close();
+		}
+		File backlog = SPIFFS.open(BACKLOG_PATH, FILE_READ);
+		const uint32_t size = backlog ? backlog.size() : 0;
+		if (backlog) backlog.close();
+		// left over from another file, or garbage: sending a few samples twice beats losing them
+		if (_backlog_pos > size || _backlog_pos % sizeof(Sample) != 0) {
+			Serial.printf("[UPLINK] Invalid backlog position %u, starting over\n", _backlog_pos);
+			_backlog_pos = 0;
+		}
+		_backlog = (size - _backlog_pos) / sizeof(Sample);
+	}
+
+	return xTaskCreatePinnedToCore(task, "uplink", 6144, this, 1, nullptr, 0) == pdPASS;
+}
+
+bool Uplink::enqueue(const Sample &sample) {
+	if (_queue == nullptr) return false;
+	return xQueueSend(_queue, &sample, 0) == pdTRUE;
+}
+
+void Uplink::task(void *pvParameters) {
+	auto self = static_cast<Uplink *>(pvParameters);
+	Sample sample;
+	while (true) {
+		if (xQueueReceive(self->_queue, &sample, pdMS_TO_TICKS(1000)) == pdTRUE) {
+			self->store(sample);
+		}
+		self->flushIfDue();
+	}
+}
+
+void Uplink::store(const Sample &sample) {
+	if (sample.timestamp < VALID_TIME_MIN) return;
+
+	if (_ring_count == RING_CAPACITY) spill();
+	_ring[(_ring_head + _ring_count) % RING_CAPACITY] = sample;
+	_ring_count++;
+}
+
+// Moves the oldest samples of the ring to the end of the backlog in SPIFFS.
+void Uplink::spill(void) {
+	const size_t n = std::min(SPILL_SIZE, _ring_count);
+	if (_backlog == 0) {
+		// nothing pending, so whatever is in SPIFFS is drained or unusable: start a fresh file
+		SPIFFS.remove(BACKLOG_PATH);
+		SPIFFS.remove(BACKLOG_POS_PATH);
+		_backlog_pos = 0;
+	}
+	const uint32_t end = _backlog_pos + _backlog * sizeof(Sample);
+
+	File backlog = SPIFFS.open(BACKLOG_PATH, FILE_APPEND);
+	// the drained prefix stays in the file until the backlog is empty, so only the rest counts
+	if (!backlog || (_backlog + n) * sizeof(Sample) > BACKLOG_SIZE_MAX) {
+		Serial.printf("[UPLINK] Backlog full, dropped %u samples\n", n);
+	} else if (backlog.size() != end) {
+		// a short write left part of a sample behind; appending would misalign everything after it
+		Serial.printf("[UPLINK] Backlog damaged, dropped %u samples\n", n);
+	} else {
+		const size_t first = std::min(n, RING_CAPACITY - _ring_head);  // the ring may wrap
+		size_t written = backlog.write(reinterpret_cast<const uint8_t *>(_ring + _ring_head),
+									   first * sizeof(Sample));
+		if (written == first * sizeof(Sample)) {
+			written += backlog.write(reinterpret_cast<const uint8_t *>(_ring),
+									 (n - first) * sizeof(Sample));
+		}
+		_backlog += written / sizeof(Sample);
+		if (written != n * sizeof(Sample)) {
+			Serial.printf("[UPLINK] SPIFFS full, dropped %u samples\n",
+						  n - written / sizeof(Sample));
+		}
+	}
+	if (backlog) backlog.close();
+
+	_ring_head = (_ring_head + n) % RING_CAPACITY;
+	_ring_count -= n;
+}
+
+size_t Uplink::readBacklog(void) {
+	File backlog = SPIFFS.open(BACKLOG_PATH, FILE_READ);
+	if (!backlog || !backlog.seek(_backlog_pos)) {
+		_backlog = 0;
+		return 0;
+	}
+	const size_t n = std::min(_batch_size, _backlog);
+	const size_t len = backlog.read(reinterpret_cast<uint8_t *>(_batch.data()), n * sizeof(Sample));
+	backlog.close();
+	return len / sizeof(Sample);
+}
+
+void Uplink::dropBacklog(size_t n) {
+	_backlog -= std::min(n, _backlog);
+	_backlog_pos += n * sizeof(Sample);
+	if (_backlog == 0) {
+		SPIFFS.remove(BACKLOG_PATH);
+		SPIFFS.remove(BACKLOG_POS_PATH);
+		_backlog_pos = 0;
+		return;
+	}
+	File pos = SPIFFS.open(BACKLOG_POS_PATH, FILE_WRITE);
+	if (pos) {
+		pos.write(reinterpret_cast<const uint8_t *>(&_backlog_pos), sizeof(_backlog_pos));
+		pos.close();
+	}
+}
+
+void Uplink::flushIfDue(void) {
+	const size_t pending = _backlog + _ring_count;
+	if (pending == 0 || static_cast<int32_t>(millis() - _next_post_ms) < 0) return;
+
+	// anything in the backlog is old enough by definition
+	const bool full = pending >= _batch_size;
+	const bool old = _backlog > 0 ||
+					 time(nullptr) - _ring[_ring_head].timestamp >= static_cast<time_t>(_batch_age);
+	if (!(full || old) || !WiFi.isConnected()) return;
+
+	size_t n = 0;
+	if (_backlog > 0) {
+		n = readBacklog();
+		if (n == 0) {
+			// whatever is left cannot be read back; don't let it hold up the ring
+			Serial.printf("[UPLINK] Backlog unreadable, dropped %u samples\n", _backlog);
+			dropBacklog(_backlog);
+		}
+	}
+	const bool from_backlog = n > 0;
+	if (!from_backlog) {
+		n = std::min(_batch_size, _ring_count);
+		for (size_t i = 0; i < n; i++) {
+			_batch[i] = _ring[(_ring_head + i) % RING_CAPACITY];
+		}
+	}
+	if (n == 0) return;
+
+	if (!post(n)) {
+		_next_post_ms = millis() + RETRY_INTERVAL_MS;
+		return;
+	}
+
+	if (from_backlog) {
+		dropBacklog(n);
+	} else {
+		_ring_head = (_ring_head + n) % RING_CAPACITY;
+		_ring_count -= n;
+	}
+	// rate limit draining a backlog; a single batch goes out right away
+	_next_post_ms = millis() + (_backlog + _ring_count >= _batch_size ? DRAIN_INTERVAL_MS : 0);
+}
+
+bool Uplink::post(size_t n) {
+	constexpr uint16_t HTTP_TIMEOUT = 3000;
+
+	_body.clear();
+	for (size_t i = 0; i < n; i++) {
+		const auto &sample = _batch[i];
+		char line[LINE_SIZE_MAX];
+		// fields of a failed sensor read are left out rather than sent as zeros
+		size_t len = appendf(line, sizeof(line), 0, "%s ", MEASUREMENT);
+		if (sample.climate_valid) {
+			len = appendf(line, sizeof(line), len, "temperature=%.1f,humidity=%ui,",
+						  sample.temperature, sample.humidity);
+		}
+		if (sample.co2 > 0) len = appendf(line, sizeof(line), len, "co2=%ui,", sample.co2);
+		len = appendf(line, sizeof(line), len, "battery=%ui %ld\n", sample.battery,
+					  static_cast<long>(sample.timestamp));
+		_body.append(line, len);
+	}
+
+	WiFiClient client;
+	HTTPClient http;
+	if (!http.begin(client, _url)) {
+		Serial.printf("[UPLINK] Failed to parse url\n");
+		return false;
+	}
+	http.setTimeout(HTTP_TIMEOUT);
+	http.addHeader("Content-Type", "text/plain; charset=utf-8");
+	if (_token[0] != '\0') http.addHeader("Authorization", String("Token ") + _token);
+
+	int httpCode = http.POST(reinterpret_cast<uint8_t *>(&_body[0]), _body.size());
+	http.end();
+	if (httpCode == HTTP_CODE_BAD_REQUEST || httpCode == HTTP_CODE_UNPROCESSABLE_ENTITY) {
+		// retrying would not help; drop the batch rather than block everything behind it
+		Serial.printf("[UPLINK] Batch of %u samples rejected\n", n);
+		return true;
+	}
+	if (httpCode < 0) {
+		Serial.printf("[UPLINK] POST... failed, error: %s\n",
+					  http.errorToString(httpCode).c_str());
+		return false;
+	}
+	if (httpCode < 200 || httpCode >= 300) {
+		Serial.printf("[UPLINK] POST... failed, code: %d\n", httpCode);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <string>
+#include <vector>
+
+#include "Sample.h"
+
+// Sends samples to a time-series database in InfluxDB line protocol, in batches of
+// batch_size samples or whatever has accumulated after batch_age seconds.
+// Samples wait in a PSRAM ring while the network is down and spill to SPIFFS once the ring is
+// full. The backlog is drained oldest first, one batch every DRAIN_INTERVAL_MS.
+class Uplink {
+public:
+	Uplink(const char *url, const char *token, size_t batch_size = 60, uint32_t batch_age = 300)
+		: _url(url), _token(token), _batch_size(batch_size), _batch_age(batch_age) {}
+
+	bool begin(void);  // returns true, if the buffers and the task could be set up
+
+	// Never blocks: the sample is dropped if the uplink task has fallen that far behind.
+	bool enqueue(const Sample &sample);
+
+private:
+	static constexpr size_t QUEUE_LENGTH = 16;
+	static constexpr size_t RING_CAPACITY = 2048;  // about three hours at one sample per 5 s
+	static constexpr size_t SPILL_SIZE = 256;
+	static constexpr size_t BACKLOG_SIZE_MAX = 1024 * 1024;
+	static constexpr uint32_t DRAIN_INTERVAL_MS = 2000;
+	static constexpr uint32_t RETRY_INTERVAL_MS = 30000;
+
+	const char *_url;
+	const char *_token;
+	size_t _batch_size;
+	uint32_t _batch_age;
+
+	QueueHandle_t _queue = nullptr;
+	Sample *_ring = nullptr;
+	size_t _ring_head = 0;
+	size_t _ring_count = 0;
+	size_t _backlog = 0;        // samples in SPIFFS
+	uint32_t _backlog_pos = 0;  // byte offset of the oldest of them
+	uint32_t _next_post_ms = 0;
+	std::vector<Sample> _batch;
+	std::string _body;
+
+	static void task(void *pvParameters);
+
+	void store(const Sample &sample);
+	void spill(void);
+	size_t readBacklog(void);
+	void dropBacklog(size_t n);
+	void flushIfDue(void);
+	bool post(size_t n);
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+namespace UplinkInfo
+{
+  // InfluxDB v2 write endpoint, or anything else accepting line protocol
+  constexpr auto URL =
+      "http://192.168.10.103:8086/api/v2/write?org=home&bucket=dashboard&precision=s";
+  constexpr auto TOKEN = "YOUR_TOKEN"; // sent as "Authorization: Token ..." unless empty
+} // namespace UplinkInfo
@@ -1,13 +1,22 @@
 #undef ARDUINO_M5STACK_FIRE
 #define ARDUINO_M5STACK_Paper
-#include <ArduinoOTA.h>
 #include <M5EPD.h>
 
 #include <array>
 #define FASTLED_INTERNAL  // suppress pragma message
 #include <FastLED.h>
 
+#include "ApiServer.h"
+#include "DamageLog.h"
+#include "FrameClient.h"
+#include "OtaInfo.h"
+#include "OtaService.h"
+#include "PowerModel.h"
 #include "SHT3X.h"
+#include "SampleHistory.h"
+#include "TouchInput.h"
+#include "Uplink.h"
+#include "UplinkInfo.h"
 #include "WiFiInfo.h"
 
 #define LGFX_M5PAPER
@@ -17,12 +26,14 @@
 
 #include "misc.h"
 #include "myFont.h"
+#include "views.h"
 #include <ESPmDNS.h>
 
 constexpr float FONT_SIZE_LARGE = 3.0;
 constexpr float FONT_SIZE_SMALL = 1.0;
-constexpr uint_fast16_t M5PAPER_SIZE_LONG_SIDE = 960;
-constexpr uint_fast16_t M5PAPER_SIZE_SHORT_SIDE = 540;
+constexpr uint_fast16_t M5PAPER_SIZE_LONG_SIDE = SCREEN_WIDTH;
+constexpr uint_fast16_t M5PAPER_SIZE_SHORT_SIDE = SCREEN_HEIGHT;
+constexpr size_t HISTORY_CAPACITY = 3600 * 24 / 5;  // one day of samples
 
 rtc_time_t time_ntp;
 rtc_date_t date_ntp{4, 1, 1, 1970};
@@ -32,6 +43,24 @@ SemaphoreHandle_t xMutex = nullptr;
 SHT3X::SHT3X sht30(wire_portA);
 static LGFX gfx;
 std::array<CRGB,3> leds;
+SampleHistory history;
+DamageLog damage;
+ApiServer api(history);
+OtaService ota(OtaInfo::PASSWORD);
+Uplink uplink(UplinkInfo::URL, UplinkInfo::TOKEN);
+PowerModel power;
+#ifdef RENDER_SERVER_URL
+FrameClient frame_client(RENDER_SERVER_URL, M5PAPER_SIZE_LONG_SIDE, M5PAPER_SIZE_SHORT_SIDE);
+#endif
+View view = View::Live;
+Sample latest_sample{};
+
+// Every refresh goes to the screenshot damage log and is charged to the power model.
+void recordRefresh(const Rect &rect, PowerModel::Activity mode) {
+	damage.add(rect);
+	power.addEpdRefresh(mode, static_cast<float>(rect.w * rect.h) /
+								  (M5PAPER_SIZE_LONG_SIDE * M5PAPER_SIZE_SHORT_SIDE));
+}
 
 inline int syncNTPTimeJP(void) {
 	constexpr auto NTP_SERVER1 = "ntp.nict.jp";
@@ -57,6 +86,9 @@ inline int syncNTPTimeJP(void) {
 void handleBtnPPress(void) {
 	xSemaphoreTake(xMutex, portMAX_DELAY);
 	prettyEpdRefresh(gfx);
+#ifdef RENDER_SERVER_URL
+	frame_client.invalidate();
+#endif
 	gfx.setTextSize(FONT_SIZE_SMALL);
 
 	gfx.startWrite();
@@ -82,6 +114,7 @@ void handleBtnPPress(void) {
 	gfx.printf("%02d:%02d:%02d", time.hour, time.min, time.sec);
 	gfx.endWrite();
 
+	recordRefresh({0, 0, gfx.width(), gfx.height()}, PowerModel::Activity::EpdQuality);
 	delay(1000);
 
 	gfx.setTextSize(FONT_SIZE_LARGE);
@@ -91,6 +124,10 @@ void handleBtnPPress(void) {
 inline void handleBtnRPress(void) {
 	xSemaphoreTake(xMutex, portMAX_DELAY);
 	prettyEpdRefresh(gfx);
+	recordRefresh({0, 0, gfx.width(), gfx.height()}, PowerModel::Activity::EpdQuality);
+#ifdef RENDER_SERVER_URL
+	frame_client.invalidate();
+#endif
 	xSemaphoreGive(xMutex);
 }
 
@@ -124,6 +161,157 @@ void handleButton(void *pvParameters) {
 	}
 }
 
+// Called from the API server task. The mutex is only held for a single row, so the render loop
+// keeps running while a screenshot is streamed.
+void readScreenRow(int32_t x, int32_t y, int32_t w, uint8_t *gray4) {
+	static std::array<lgfx::rgb888_t, M5PAPER_SIZE_LONG_SIDE> rgb;
+
+	xSemaphoreTake(xMutex, portMAX_DELAY);
+	gfx.readRect(x, y, w, 1, rgb.data());
+	xSemaphoreGive(xMutex);
+	for (int32_t i = 0; i < w; i++) {
+		gray4[i] = rgb[i].g >> 4;
+	}
+}
+
+void drawLivePanel(const Sample &sample, const rtc_time_t &time) {
+	gfx.setCursor(0, VIEW_AREA.y);
+	gfx.setClipRect(VIEW_AREA.x, VIEW_AREA.y, M5PAPER_SIZE_LONG_SIDE - VIEW_AREA.x,
+					M5PAPER_SIZE_SHORT_SIDE - VIEW_AREA.y);
+	gfx.printf("%02d:%02d:%02d\r\n", time.hour, time.min, time.sec);
+	gfx.printf("%04dppm\r\n", sample.co2);
+	gfx.printf("%02.1f℃\r\n", sample.temperature);
+	gfx.printf("%0d%%", sample.humidity);
+	gfx.clearClipRect();
+}
+
+void drawLeftPanel(const Sample &sample, const rtc_time_t &time) {
+	if (view == View::Live) {
+		drawLivePanel(sample, time);
+	} else {
+		drawViewPanel(gfx, view, history);
+	}
+}
+
+void drawDashboard(const Sample &sample) {
+	rtc_date_t date;
+	rtc_time_t time;
+
+	M5.RTC.getDateTime(date, time);
+
+	gfx.startWrite();
+	gfx.fillScreen(TFT_WHITE);
+	gfx.fillRect(DIVIDER_X, 0, DIVIDER_WIDTH, SCREEN_HEIGHT, TFT_BLACK);
+
+	drawLeftPanel(sample, time);
+
+	constexpr float x = 0.61 * M5PAPER_SIZE_LONG_SIDE;
+	gfx.setCursor(0, MARGIN_Y);
+	gfx.setClipRect(x, MARGIN_Y, M5PAPER_SIZE_LONG_SIDE - MARGIN_X - x,
+					M5PAPER_SIZE_SHORT_SIDE - MARGIN_Y);
+	gfx.printf("%04d\r\n", date.year);
+	gfx.printf("%02d/%02d\r\n", date.mon, date.day);
+	gfx.println(weekdayToString(date.week));
+	gfx.clearClipRect();
+
+	constexpr float offset_y_info = 0.75 * M5PAPER_SIZE_SHORT_SIDE;
+	gfx.setCursor(0, offset_y_info);
+	gfx.setTextSize(FONT_SIZE_SMALL);
+	gfx.setClipRect(x, offset_y_info, M5PAPER_SIZE_LONG_SIDE - x, gfx.height() - offset_y_info);
+	gfx.print("WiFi: ");
+	gfx.println(WiFiConnectedToString());
+	gfx.printf("BAT : %04dmv", sample.battery);
+	const auto report = power.report();
+	if (report.charging) {
+		gfx.print(" CHG");
+	} else if (!std::isnan(report.hours_remaining)) {
+		gfx.printf(" %dh", static_cast<int>(std::min(report.hours_remaining, 999.0f)));
+	}
+	gfx.println();
+	gfx.print("NTP : ");
+	if (date_ntp.year == 1970) {
+		gfx.print("YET");  // not initialized
+	} else {
+		gfx.printf("%02d/%02d %02d:%02d", date_ntp.mon, date_ntp.day, time_ntp.hour, time_ntp.min);
+	}
+
+	gfx.clearClipRect();
+	gfx.setTextSize(FONT_SIZE_LARGE);
+	gfx.endWrite();
+	recordRefresh({0, 0, gfx.width(), gfx.height()}, PowerModel::Activity::EpdFast);
+}
+
+// Redraws only the left panel, in the fastest EPD mode. The next loop() redraws the whole screen
+// in the usual mode, which also clears the ghosting the fastest mode leaves behind.
+void switchView(View next) {
+	rtc_date_t date;
+	rtc_time_t time;
+
+	M5.RTC.getDateTime(date, time);
+
+	view = next;
+	gfx.setEpdMode(epd_mode_t::epd_fastest);
+	gfx.startWrite();
+	gfx.fillRect(LEFT_PANEL.x, LEFT_PANEL.y, LEFT_PANEL.w, LEFT_PANEL.h, TFT_WHITE);
+	drawLeftPanel(latest_sample, time);
+	gfx.endWrite();
+	gfx.setEpdMode(epd_mode_t::epd_fast);
+	recordRefresh(LEFT_PANEL, PowerModel::Activity::EpdFastest);
+}
+
+// Touch-to-first-pixel: from the finger leaving the panel to the refresh being handed to the EPD.
+void recordTouchLatency(uint32_t latency) {
+	static uint32_t count = 0;
+	static uint32_t total = 0;
+	static uint32_t max = 0;
+
+	count++;
+	total += latency;
+	max = std::max(max, latency);
+	Serial.printf("[TOUCH] latency: %ums (avg %ums, max %ums)\n", latency, total / count, max);
+}
+
+void handleTouch(void *pvParameters) {
+	constexpr uint32_t TOUCH_POLL_MS = 20;
+
+	auto source = static_cast<TouchSource *>(pvParameters);
+	GestureDetector detector;
+	TouchPoint point{};
+
+	while (true) {
+		delay(TOUCH_POLL_MS);
+		if (!source->read(point)) continue;
+		const auto event = detector.update(point);
+		if (event.gesture == Gesture::None) continue;
+
+		xSemaphoreTake(xMutex, portMAX_DELAY);
+		const int32_t live_row = (event.y - VIEW_AREA.y) / gfx.fontHeight();
+		const View next = navigate(view, event, live_row);
+		if (next != view) {
+			switchView(next);
+			recordTouchLatency(millis() - event.ms);
+		}
+		xSemaphoreGive(xMutex);
+	}
+}
+
+#ifdef RENDER_SERVER_URL
+// Redraws only the tiles the render server reports as changed.
+void drawServerFrame(void) {
+	const FrameClient::Sink sink{
+		[]() { gfx.startWrite(); },
+		[](int32_t x, int32_t y, int32_t w, uint8_t gray4) {
+			const uint8_t level = gray4 * 17;
+			gfx.writeFastHLine(x, y, w, gfx.color888(level, level, level));
+		},
+		[](const Rect &area) {
+			gfx.endWrite();
+			if (!area.empty()) recordRefresh(area, PowerModel::Activity::EpdFast);
+		}};
+	frame_client.update(sink);
+}
+#endif
+
 void setup(void) {
 	constexpr uint_fast16_t WIFI_CONNECT_RETRY_MAX = 60;  // 10 = 5s
 	constexpr uint_fast16_t WAIT_ON_FAILURE = 2000;
@@ -152,42 +340,16 @@ void setup(void) {
 		gfx.print("Local IP: ");
 		gfx.println(WiFi.localIP());
 		MDNS.begin("m5paper");
+		MDNS.addService("http", "tcp", 80);
+		// samples are timestamped with the system clock, which is only set by NTP
+		if (syncNTPTimeJP()) {
+			gfx.println("Failed to sync time");
+		}
 	} else {
 		gfx.println("Failed to connect to a Wi-Fi network");
 		delay(WAIT_ON_FAILURE);
 	}
 
-	ArduinoOTA
-		.onStart([]() {
-			String type;
-			if (ArduinoOTA.getCommand() == U_FLASH)
-				type = "sketch";
-			else  // U_SPIFFS
-				type = "filesystem";
-
-			// NOTE: if updating SPIFFS this would be the place to unmount SPIFFS using SPIFFS.end()
-			Serial.println("Start updating " + type);
-		})
-		.onEnd([]() { Serial.println("\nEnd"); })
-		.onProgress([](unsigned int progress, unsigned int total) {
-			Serial.printf("Progress: %u%%\r", (progress / (total / 100)));
-		})
-		.onError([](ota_error_t error) {
-			Serial.printf("Error[%u]: ", error);
-			if (error == OTA_AUTH_ERROR)
-				Serial.println("Auth Failed");
-			else if (error == OTA_BEGIN_ERROR)
-				Serial.println("Begin Failed");
-			else if (error == OTA_CONNECT_ERROR)
-				Serial.println("Connect Failed");
-			else if (error == OTA_RECEIVE_ERROR)
-				Serial.println("Receive Failed");
-			else if (error == OTA_END_ERROR)
-				Serial.println("End Failed");
-		});
-
-	ArduinoOTA.begin();
-
 	// env2 unit
 	if (!sht30.begin(25, 32, 400000)) {
 		gfx.println("Failed to initialize external I2C");
@@ -200,6 +362,33 @@ void setup(void) {
 	} else {
 		gfx.println("Failed to create a task for buttons");
 	}
+
+#ifndef RENDER_SERVER_URL
+	static GT911TouchSource<GT911> touch_source(M5.TP, []() -> uint32_t { return millis(); });
+	M5.TP.SetRotation(0);
+	// below every other task: gestures only run when nothing else needs the CPU
+	if (xMutex == nullptr || xTaskCreatePinnedToCore(handleTouch, "handleTouch", 8192,
+													  &touch_source, tskIDLE_PRIORITY, nullptr,
+													  1) != pdPASS) {
+		gfx.println("Failed to create a task for touch");
+	}
+#endif
+
+	if (xMutex == nullptr || !ota.begin(xMutex)) {
+		gfx.println("Failed to create a task for OTA");
+	}
+
+	if (!history.begin(HISTORY_CAPACITY)) {
+		gfx.println("Failed to allocate history buffer");
+	}
+	api.enableScreenshot(damage, gfx.width(), gfx.height(), readScreenRow);
+	api.enablePower(power);
+	if (!api.begin()) {
+		gfx.println("Failed to create a task for API server");
+	}
+	if (!uplink.begin()) {
+		gfx.println("Failed to create a task for uplink");
+	}
 	gfx.println("Init done");
 	delay(1000);
 	gfx.setTextSize(FONT_SIZE_LARGE);
@@ -212,72 +401,46 @@ void loop(void) {
 	constexpr uint_fast32_t TIME_SYNC_CYCLE = 3600 * 24 / SLEEP_SEC;
 
 	static uint32_t cnt = 0;
-
-	xSemaphoreTake(xMutex, portMAX_DELAY);
-	ArduinoOTA.handle();
+	const uint32_t busy_start = millis();
 
 	float tmp = 0.0;
 	uint_fast8_t hum = 0;
+	bool climate_valid = false;
 
 	if (!sht30.read()) {
 		tmp = sht30.getTemperature();
 		hum = sht30.getHumidity();
+		climate_valid = true;
 	}
+	const uint32_t http_start = millis();
 	auto co2 = getCo2Data();
+	uint32_t http_ms = millis() - http_start;
 	setLEDColor(leds, co2);
 
-	rtc_date_t date;
-	rtc_time_t time;
-
-	M5.RTC.getDateTime(date, time);
-
-	gfx.startWrite();
-	gfx.fillScreen(TFT_WHITE);
-	gfx.fillRect(0.57 * M5PAPER_SIZE_LONG_SIDE, 0, 3, M5PAPER_SIZE_SHORT_SIDE, TFT_BLACK);
-
-	constexpr uint_fast16_t offset_y = 30;
-	constexpr uint_fast16_t offset_x = 45;
-
-	gfx.setCursor(0, offset_y);
-	gfx.setClipRect(offset_x, offset_y, M5PAPER_SIZE_LONG_SIDE - offset_x,
-					M5PAPER_SIZE_SHORT_SIDE - offset_y);
-	gfx.printf("%02d:%02d:%02d\r\n", time.hour, time.min, time.sec);
-	gfx.printf("%04dppm\r\n", co2);
-	gfx.printf("%02.1f℃\r\n", tmp);
-	gfx.printf("%0d%%", hum);
-	gfx.clearClipRect();
-
-	constexpr float x = 0.61 * M5PAPER_SIZE_LONG_SIDE;
-	gfx.setCursor(0, offset_y);
-	gfx.setClipRect(x, offset_y, M5PAPER_SIZE_LONG_SIDE - offset_x - x,
-					M5PAPER_SIZE_SHORT_SIDE - offset_y);
-	gfx.printf("%04d\r\n", date.year);
-	gfx.printf("%02d/%02d\r\n", date.mon, date.day);
-	gfx.println(weekdayToString(date.week));
-	gfx.clearClipRect();
-
-	constexpr float offset_y_info = 0.75 * M5PAPER_SIZE_SHORT_SIDE;
-	gfx.setCursor(0, offset_y_info);
-	gfx.setTextSize(FONT_SIZE_SMALL);
-	gfx.setClipRect(x, offset_y_info, M5PAPER_SIZE_LONG_SIDE - x, gfx.height() - offset_y_info);
-	gfx.print("WiFi: ");
-	gfx.println(WiFiConnectedToString());
-
 	constexpr uint32_t low = 3300;
 	constexpr uint32_t high = 4350;
 
-	auto vol = std::min(std::max(M5.getBatteryVoltage(), low), high);
-	gfx.printf("BAT : %04dmv\r\n", vol);
-	gfx.print("NTP : ");
-	if (date_ntp.year == 1970) {
-		gfx.print("YET");  // not initialized
-	} else {
-		gfx.printf("%02d/%02d %02d:%02d", date_ntp.mon, date_ntp.day, time_ntp.hour, time_ntp.min);
-	}
+	const uint32_t raw_vol = M5.getBatteryVoltage();
+	auto vol = std::min(std::max(raw_vol, low), high);
 
-	gfx.clearClipRect();
-	gfx.setTextSize(FONT_SIZE_LARGE);
-	gfx.endWrite();
+	const Sample sample{time(nullptr), tmp, static_cast<uint16_t>(co2), static_cast<uint16_t>(vol),
+						static_cast<uint8_t>(hum), climate_valid};
+	history.push(sample);
+	api.publish(sample);
+	uplink.enqueue(sample);
+
+	// only drawing needs the lock, so touch input is not held up by the sensor requests
+	xSemaphoreTake(xMutex, portMAX_DELAY);
+	latest_sample = sample;
+
+#ifdef RENDER_SERVER_URL
+	// the tiles are drawn as they arrive, so all of it counts as the fetch
+	const uint32_t frame_start = millis();
+	drawServerFrame();
+	http_ms += millis() - frame_start;
+#else
+	drawDashboard(sample);
+#endif
 
 	cnt++;
 	if (cnt == TIME_SYNC_CYCLE) {
@@ -285,5 +448,20 @@ void loop(void) {
 		cnt = 0;
 	}
 	xSemaphoreGive(xMutex);
+
+	// the LEDs and Wi-Fi stay as they are through the sleep, so they are charged for the whole
+	// cycle
+	const uint32_t busy_ms = millis() - busy_start;
+	const uint32_t cycle_ms = busy_ms + SLEEP_SEC * 1000;
+	const auto lit = std::count_if(leds.begin(), leds.end(),
+								   [](const CRGB &led) { return static_cast<bool>(led); });
+	power.addTime(PowerModel::Activity::Http, http_ms);
+	power.addTime(PowerModel::Activity::Cpu, busy_ms - http_ms);
+	power.addTime(PowerModel::Activity::Led, lit * cycle_ms);
+	if (WiFi.isConnected()) {
+		power.addTime(PowerModel::Activity::WiFi, cycle_ms);
+	}
+	power.endCycle(cycle_ms, raw_vol);
+
 	delay(SLEEP_SEC * 1000);
 }
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include "Navigation.h"
+#include "SampleHistory.h"
+
+constexpr time_t CHART_SPAN = 3600 * 24;
+constexpr float LABEL_TEXT_SIZE = 1.0;
+constexpr int32_t LABEL_HEIGHT = 40;
+
+inline float metricValue(const Sample &sample, Metric metric) {
+	switch (metric) {
+		case Metric::Co2:
+			return sample.co2 > 0 ? sample.co2 : NAN;  // 0: the sensor could not be reached
+		case Metric::Temperature:
+			return sample.climate_valid ? sample.temperature : NAN;
+		case Metric::Humidity:
+			return sample.climate_valid ? sample.humidity : NAN;
+	}
+	return NAN;
+}
+
+struct ChartStats {
+	float min;
+	float max;
+	float avg;
+	size_t count;
+};
+
+// Plots the last CHART_SPAN seconds of a metric as the min-max range of each pixel column.
+inline ChartStats drawChart(LGFX &gfx, SampleHistory &history, Metric metric, const Rect &area) {
+	std::vector<float> lo(area.w, INFINITY);
+	std::vector<float> hi(area.w, -INFINITY);
+	ChartStats stats{INFINITY, -INFINITY, 0, 0};
+	double sum = 0;
+
+	const time_t now = time(nullptr);
+	const time_t from = now - CHART_SPAN;
+	std::array<Sample, 16> samples;
+	uint32_t seq = 0;
+	size_t n;
+	while ((n = history.read(seq, samples.data(), samples.size())) > 0) {
+		for (size_t i = 0; i < n; i++) {
+			const auto timestamp = samples[i].timestamp;
+			const float value = metricValue(samples[i], metric);
+			if (timestamp < from || timestamp > now || std::isnan(value)) continue;
+
+			const size_t col = (timestamp - from) * (area.w - 1) / CHART_SPAN;
+			lo[col] = std::min(lo[col], value);
+			hi[col] = std::max(hi[col], value);
+			stats.min = std::min(stats.min, value);
+			stats.max = std::max(stats.max, value);
+			sum += value;
+			stats.count++;
+		}
+	}
+
+	gfx.drawRect(area.x, area.y, area.w, area.h, TFT_BLACK);
+	if (stats.count == 0) return stats;
+	stats.avg = sum / stats.count;
+
+	// a nearly flat series would otherwise be stretched over the whole height
+	float bottom = stats.min;
+	float top = stats.max;
+	const float span_min = metricInfo(metric).span_min;
+	if (top - bottom < span_min) {
+		bottom = (top + bottom - span_min) / 2;
+		top = bottom + span_min;
+	}
+	auto toY = [&](float value) {
+		const float ratio = (value - bottom) / (top - bottom);
+		return area.y + area.h - 2 - static_cast<int32_t>(ratio * (area.h - 3));
+	};
+
+	for (int32_t col = 0; col < area.w; col++) {
+		if (lo[col] > hi[col]) continue;  // no samples
+		const int32_t y_top = toY(hi[col]);
+		gfx.drawFastVLine(area.x + col, y_top, toY(lo[col]) - y_top + 1, TFT_BLACK);
+	}
+	return stats;
+}
+
+inline void drawLabel(LGFX &gfx, int32_t x, int32_t y, const char *prefix, Metric metric,
+					  float value) {
+	char label[32];
+	auto len = snprintf(label, sizeof(label), "%s ", prefix);
+	snprintf(label + len, sizeof(label) - len, metricInfo(metric).format, value);
+	gfx.drawString(label, x, y);
+}
+
+// Draws every view but the live one, which main.cpp draws itself.
+inline void drawViewPanel(LGFX &gfx, View view, SampleHistory &history) {
+	const auto text_size = gfx.getTextSizeX();
+	gfx.setTextSize(LABEL_TEXT_SIZE);
+	gfx.setClipRect(VIEW_AREA.x, VIEW_AREA.y, VIEW_AREA.w, VIEW_AREA.h);
+
+	if (view == View::History) {
+		for (uint8_t i = 0; i < METRICS.size(); i++) {
+			const int32_t y = VIEW_AREA.y + i * HISTORY_SLOT_HEIGHT;
+			const auto metric = static_cast<Metric>(i);
+			const auto stats =
+				drawChart(gfx, history, metric,
+						  {VIEW_AREA.x, y + LABEL_HEIGHT, VIEW_AREA.w,
+						   HISTORY_SLOT_HEIGHT - LABEL_HEIGHT - 10});
+			gfx.drawString(metricInfo(metric).name, VIEW_AREA.x, y);
+			if (stats.count > 0) {
+				drawLabel(gfx, VIEW_AREA.x + VIEW_AREA.w / 3, y, "max", metric, stats.max);
+			}
+		}
+	} else {
+		const auto metric = detailMetric(view);
+		const auto &info = metricInfo(metric);
+		gfx.drawString(info.name, VIEW_AREA.x, VIEW_AREA.y);
+		gfx.drawString("24h", VIEW_AREA.x + VIEW_AREA.w - 3 * LABEL_HEIGHT, VIEW_AREA.y);
+
+		constexpr int32_t CHART_HEIGHT = 300;
+		const auto stats = drawChart(gfx, history, metric,
+									 {VIEW_AREA.x, VIEW_AREA.y + LABEL_HEIGHT, VIEW_AREA.w,
+									  CHART_HEIGHT});
+		int32_t y = VIEW_AREA.y + LABEL_HEIGHT + CHART_HEIGHT + 10;
+		if (stats.count == 0) {
+			gfx.drawString("No data", VIEW_AREA.x, y);
+		} else {
+			drawLabel(gfx, VIEW_AREA.x, y, "max", metric, stats.max);
+			drawLabel(gfx, VIEW_AREA.x, y + LABEL_HEIGHT, "avg", metric, stats.avg);
+			drawLabel(gfx, VIEW_AREA.x, y + 2 * LABEL_HEIGHT, "min", metric, stats.min);
+		}
+	}
+
+	gfx.clearClipRect();
+	gfx.setTextSize(text_size);
+}
@@ -0,0 +1,207 @@
+#include <unity.h>
+
+#include <deque>
+
+#include "Navigation.h"
+#include "TouchInput.h"
+
+namespace {
+uint32_t now_ms = 0;
+uint32_t fakeClock(void) { return now_ms; }
+
+// Behaves like M5EPD's GT911: avaliable() reports an interrupt, and the finger count and
+// coordinates only change when update() reads the report. Lifting the finger is one last report
+// without fingers.
+class FakeGT911 {
+public:
+	struct Finger {
+		uint16_t x;
+		uint16_t y;
+	};
+
+	void touch(uint16_t x, uint16_t y, uint32_t ms) { _reports.push_back({1, {x, y}, ms}); }
+	void lift(uint32_t ms) { _reports.push_back({0, {0, 0}, ms}); }
+
+	bool avaliable(void) {
+		if (_reports.empty() || _pending) return false;
+		_pending = true;
+		now_ms = _reports.front().ms;
+		return true;
+	}
+	void update(void) {
+		if (!_pending) return;
+		_pending = false;
+		_num = _reports.front().num;
+		if (_num > 0) _finger = _reports.front().finger;
+		_reports.pop_front();
+	}
+	uint8_t getFingerNum(void) { return _num; }
+	Finger readFinger(uint8_t) { return _finger; }
+
+private:
+	struct Report {
+		uint8_t num;
+		Finger finger;
+		uint32_t ms;
+	};
+	std::deque<Report> _reports;
+	bool _pending = false;
+	uint8_t _num = 0;
+	Finger _finger{0, 0};
+};
+
+// Feeds every report of a source through a detector; returns the last gesture recognized.
+GestureEvent recognize(TouchSource &source) {
+	GestureDetector detector;
+	GestureEvent last{Gesture::None, 0, 0, 0};
+	TouchPoint point{};
+	while (source.read(point)) {
+		const auto event = detector.update(point);
+		if (event.gesture != Gesture::None) last = event;
+	}
+	return last;
+}
+
+View navigateBy(View view, MockTouchSource &source, int32_t live_row = 0) {
+	return navigate(view, recognize(source), live_row);
+}
+}  // namespace
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_tap(void) {
+	MockTouchSource source;
+	source.tap(200, 300, 1000);
+	const auto event = recognize(source);
+	TEST_ASSERT_EQUAL(static_cast<int>(Gesture::Tap), static_cast<int>(event.gesture));
+	TEST_ASSERT_EQUAL(200, event.x);
+	TEST_ASSERT_EQUAL(300, event.y);
+	TEST_ASSERT_EQUAL(1050, event.ms);
+}
+
+void test_swipe_left_and_right(void) {
+	MockTouchSource source;
+	source.swipe(400, 270, 100, 280, 1000);
+	TEST_ASSERT_EQUAL(static_cast<int>(Gesture::SwipeLeft),
+					  static_cast<int>(recognize(source).gesture));
+	source.swipe(100, 270, 400, 260, 2000);
+	TEST_ASSERT_EQUAL(static_cast<int>(Gesture::SwipeRight),
+					  static_cast<int>(recognize(source).gesture));
+
+	source.swipe(400, 270, 100, 270, 3000);
+	TEST_ASSERT_EQUAL(static_cast<int>(View::History),
+					  static_cast<int>(navigateBy(View::Live, source)));
+	source.swipe(100, 270, 400, 270, 4000);
+	TEST_ASSERT_EQUAL(static_cast<int>(View::Live),
+					  static_cast<int>(navigateBy(View::History, source)));
+}
+
+void test_long_press_is_not_a_tap(void) {
+	MockTouchSource source;
+	source.push({true, 200, 300, 1000});
+	source.push({true, 202, 301, 1400});
+	source.push({false, 202, 301, 1800});
+	TEST_ASSERT_EQUAL(static_cast<int>(Gesture::None),
+					  static_cast<int>(recognize(source).gesture));
+}
+
+void test_short_drag_is_neither_tap_nor_swipe(void) {
+	MockTouchSource source;
+	source.swipe(200, 300, 250, 300, 1000);
+	TEST_ASSERT_EQUAL(static_cast<int>(Gesture::None),
+					  static_cast<int>(recognize(source).gesture));
+}
+
+void test_tap_on_reading_opens_detail(void) {
+	MockTouchSource source;
+	source.tap(200, 300, 1000);
+	TEST_ASSERT_EQUAL(static_cast<int>(View::DetailTemperature),
+					  static_cast<int>(navigateBy(View::Live, source, 2)));
+}
+
+void test_tap_right_of_left_panel_is_ignored(void) {
+	MockTouchSource source;
+	for (auto view : {View::Live, View::History, View::DetailCo2}) {
+		source.tap(LEFT_PANEL.w + 10, VIEW_AREA.y + 10, 1000);
+		TEST_ASSERT_EQUAL(static_cast<int>(view), static_cast<int>(navigateBy(view, source, 1)));
+	}
+}
+
+void test_tap_on_history_chart_opens_detail(void) {
+	MockTouchSource source;
+	source.tap(200, VIEW_AREA.y + 2 * HISTORY_SLOT_HEIGHT + 10, 1000);
+	TEST_ASSERT_EQUAL(static_cast<int>(View::DetailHumidity),
+					  static_cast<int>(navigateBy(View::History, source)));
+}
+
+void test_detail_pages_wrap_around(void) {
+	MockTouchSource source;
+	source.swipe(400, 270, 100, 270, 1000);
+	TEST_ASSERT_EQUAL(static_cast<int>(View::DetailCo2),
+					  static_cast<int>(navigateBy(View::DetailHumidity, source)));
+	source.swipe(100, 270, 400, 270, 2000);
+	TEST_ASSERT_EQUAL(static_cast<int>(View::DetailHumidity),
+					  static_cast<int>(navigateBy(View::DetailCo2, source)));
+	source.tap(200, 300, 3000);
+	TEST_ASSERT_EQUAL(static_cast<int>(View::Live),
+					  static_cast<int>(navigateBy(View::DetailTemperature, source)));
+}
+
+void test_gt911_release_ends_the_touch(void) {
+	FakeGT911 driver;
+	GT911TouchSource<FakeGT911> source(driver, fakeClock);
+	driver.touch(200, 300, 1000);
+	driver.lift(1050);
+
+	TouchPoint point{};
+	TEST_ASSERT_TRUE(source.read(point));
+	TEST_ASSERT_TRUE(point.down);
+	TEST_ASSERT_EQUAL(200, point.x);
+	TEST_ASSERT_EQUAL(300, point.y);
+	TEST_ASSERT_TRUE(source.read(point));
+	TEST_ASSERT_FALSE(point.down);
+	TEST_ASSERT_EQUAL(1050, point.ms);
+	TEST_ASSERT_FALSE(source.read(point));
+}
+
+void test_gt911_tap(void) {
+	FakeGT911 driver;
+	GT911TouchSource<FakeGT911> source(driver, fakeClock);
+	driver.touch(200, 300, 1000);
+	driver.touch(202, 301, 1020);
+	driver.lift(1060);
+	const auto event = recognize(source);
+	TEST_ASSERT_EQUAL(static_cast<int>(Gesture::Tap), static_cast<int>(event.gesture));
+	TEST_ASSERT_EQUAL(200, event.x);
+	TEST_ASSERT_EQUAL(300, event.y);
+	TEST_ASSERT_EQUAL(1060, event.ms);
+}
+
+void test_gt911_swipe_is_recognized_on_release(void) {
+	FakeGT911 driver;
+	GT911TouchSource<FakeGT911> source(driver, fakeClock);
+	for (int i = 0; i <= 5; i++) {
+		driver.touch(400 - i * 60, 270, 1000 + i * 20);
+	}
+	driver.lift(1120);
+	const auto event = recognize(source);
+	TEST_ASSERT_EQUAL(static_cast<int>(Gesture::SwipeLeft), static_cast<int>(event.gesture));
+	TEST_ASSERT_EQUAL(1120, event.ms);
+}
+
+int main(void) {
+	UNITY_BEGIN();
+	RUN_TEST(test_tap);
+	RUN_TEST(test_swipe_left_and_right);
+	RUN_TEST(test_long_press_is_not_a_tap);
+	RUN_TEST(test_short_drag_is_neither_tap_nor_swipe);
+	RUN_TEST(test_tap_on_reading_opens_detail);
+	RUN_TEST(test_tap_right_of_left_panel_is_ignored);
+	RUN_TEST(test_tap_on_history_chart_opens_detail);
+	RUN_TEST(test_detail_pages_wrap_around);
+	RUN_TEST(test_gt911_release_ends_the_touch);
+	RUN_TEST(test_gt911_tap);
+	RUN_TEST(test_gt911_swipe_is_recognized_on_release);
+	return UNITY_END();
+}
@@ -0,0 +1,71 @@
+"""Stand-in ingestion server for the uplink (see src/Uplink.h).
+
+Accepts InfluxDB line protocol on any POST path and logs it. The status it answers with can
+be switched while it runs, to exercise the retry, backlog and drop paths of the device:
+
+    python3 tools/ingest_server.py --port 8086
+    curl "http://localhost:8086/control?status=503"  # fail every batch: samples pile up
+    curl "http://localhost:8086/control?status=400"  # reject every batch: batches are dropped
+    curl "http://localhost:8086/control?status=204"  # accept again: the backlog drains
+"""
+
+import argparse
+import http.server
+import time
+import urllib.parse
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    def do_GET(self):
+        url = urllib.parse.urlparse(self.path)
+        query = urllib.parse.parse_qs(url.query)
+        if url.path != "/control" or "status" not in query:
+            self.respond(404, "use /control?status=<code>\n")
+            return
+        self.server.status = int(query["status"][0])
+        self.log_message("answering POSTs with %d from now on", self.server.status)
+        self.respond(200, f"status {self.server.status}\n")
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        lines = self.rfile.read(length).decode("utf-8", "replace").splitlines()
+        status = self.server.status
+
+        timestamps = [int(t) for t in (line.rsplit(" ", 1)[-1] for line in lines) if t.isdigit()]
+        span = ""
+        if timestamps:
+            first, last = min(timestamps), max(timestamps)
+            span = " from %s to %s" % (time.strftime("%H:%M:%S", time.localtime(first)),
+                                       time.strftime("%H:%M:%S", time.localtime(last)))
+        self.log_message("%d lines%s (auth: %s) -> %d", len(lines), span,
+                         self.headers.get("Authorization", "none"), status)
+        if self.server.verbose:
+            for line in lines:
+                print("  " + line)
+        self.respond(status, "" if status < 300 else f"status {status} on request\n")
+
+    def respond(self, status, body):
+        data = body.encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "text/plain")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=8086)
+    parser.add_argument("--status", type=int, default=204, help="status to answer POSTs with")
+    parser.add_argument("-v", "--verbose", action="store_true", help="print every line")
+    args = parser.parse_args()
+
+    server = http.server.HTTPServer(("", args.port), Handler)
+    server.status = args.status
+    server.verbose = args.verbose
+    print(f"Accepting line protocol on :{args.port}, answering {args.status}")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,159 @@
+"""Stand-in render server for RENDER_SERVER_URL (see src/FrameClient.h for the format).
+
+Draws a clock with a seconds bar, or serves a fixed image, and answers with only the tiles
+that changed since the frame named in If-None-Match.
+
+    python3 tools/render_server.py --port 8000
+    python3 tools/render_server.py --pgm picture.pgm
+"""
+
+import argparse
+import collections
+import hashlib
+import http.server
+import struct
+import time
+
+WIDTH = 960
+HEIGHT = 540
+WHITE = 15
+BLACK = 0
+FRAMES_KEPT = 8  # frames a device may still be showing
+
+# segments a-g of each digit, clockwise from the top, then the middle one
+DIGITS = {
+    "0": "abcdef", "1": "bc", "2": "abdeg", "3": "abcdg", "4": "bcfg",
+    "5": "acdfg", "6": "acdefg", "7": "abc", "8": "abcdefg", "9": "abcdfg",
+}
+
+
+def fill(frame, x, y, w, h, gray):
+    for row in range(y, y + h):
+        frame[row * WIDTH + x:row * WIDTH + x + w] = bytes([gray]) * w
+
+
+def draw_digit(frame, x, y, digit, size=40, thick=16):
+    segments = {
+        "a": (x, y, 3 * size, thick),
+        "b": (x + 3 * size - thick, y, thick, 3 * size),
+        "c": (x + 3 * size - thick, y + 3 * size, thick, 3 * size),
+        "d": (x, y + 6 * size - thick, 3 * size, thick),
+        "e": (x, y + 3 * size, thick, 3 * size),
+        "f": (x, y, thick, 3 * size),
+        "g": (x, y + 3 * size - thick // 2, 3 * size, thick),
+    }
+    for segment in DIGITS[digit]:
+        fill(frame, *segments[segment], BLACK)
+
+
+def render_clock(now):
+    frame = bytearray([WHITE]) * (WIDTH * HEIGHT)
+    text = time.strftime("%H%M", time.localtime(now))
+    for i, digit in enumerate(text):
+        draw_digit(frame, 90 + i * 200 + (40 if i >= 2 else 0), 60, digit)
+    fill(frame, 465, 160, 30, 30, BLACK)  # colon
+    fill(frame, 465, 250, 30, 30, BLACK)
+    seconds = int(now) % 60
+    fill(frame, 60, 420, 840, 4, 8)
+    fill(frame, 60, 440, 14 * seconds, 60, 4)
+    return bytes(frame)
+
+
+def load_pgm(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    # P5 header: magic, width, height, maxval, each followed by whitespace
+    fields = data.split(maxsplit=4)
+    if fields[0] != b"P5":
+        raise ValueError("only binary PGM (P5) is supported")
+    width, height, maxval = (int(v) for v in fields[1:4])
+    if (width, height) != (WIDTH, HEIGHT) or maxval > 255:
+        raise ValueError(f"expected {WIDTH}x{HEIGHT} with 8-bit gray")
+    pixels = data[len(data) - width * height:]
+    return bytes(round(p * 15 / maxval) for p in pixels)
+
+
+def tile_pixels(frame, index, size):
+    per_row = (WIDTH + size - 1) // size
+    x, y = index % per_row * size, index // per_row * size
+    w, h = min(size, WIDTH - x), min(size, HEIGHT - y)
+    return b"".join(frame[row * WIDTH + x:row * WIDTH + x + w] for row in range(y, y + h))
+
+
+def encode_tile(pixels):
+    out = bytearray()
+    i = 0
+    while i < len(pixels):
+        gray = pixels[i]
+        run = 1
+        while i + run < len(pixels) and pixels[i + run] == gray and run < 16 + 255:
+            run += 1
+        if run < 16:
+            out.append((run - 1) << 4 | gray)
+        else:
+            out += bytes([0xF0 | gray, run - 16])
+        i += run
+    return bytes(out)
+
+
+def encode_frame(frame, previous, size):
+    tiles = ((WIDTH + size - 1) // size) * ((HEIGHT + size - 1) // size)
+    body = bytearray()
+    count = 0
+    for index in range(tiles):
+        pixels = tile_pixels(frame, index, size)
+        if previous is not None and tile_pixels(previous, index, size) == pixels:
+            continue
+        payload = encode_tile(pixels)
+        body += struct.pack("<HH", index, len(payload)) + payload
+        count += 1
+    return b"M5TD" + struct.pack("<BHH", 1, size, count) + body, count
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    frames = collections.OrderedDict()  # ETag -> frame
+
+    def do_GET(self):
+        frame = self.server.image if self.server.image else render_clock(time.time())
+        etag = '"%s"' % hashlib.sha1(frame).hexdigest()[:16]
+        known = self.headers.get("If-None-Match")
+
+        if known == etag:
+            self.send_response(304)
+            self.send_header("ETag", etag)
+            self.end_headers()
+            return
+
+        previous = self.frames.get(known)
+        body, count = encode_frame(frame, previous, self.server.tile_size)
+        self.frames[etag] = frame
+        self.frames.move_to_end(etag)
+        while len(self.frames) > FRAMES_KEPT:
+            self.frames.popitem(last=False)
+
+        self.log_message("%d tiles, %d bytes (%s)", count, len(body),
+                         "full" if previous is None else "delta")
+        self.send_response(200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(body)))
+        self.send_header("ETag", etag)
+        self.end_headers()
+        self.wfile.write(body)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--tile", type=int, default=120, help="tile size, at most 120")
+    parser.add_argument("--pgm", help=f"serve this {WIDTH}x{HEIGHT} image instead of the clock")
+    args = parser.parse_args()
+
+    server = http.server.HTTPServer(("", args.port), Handler)
+    server.tile_size = min(args.tile, 120)
+    server.image = load_pgm(args.pgm) if args.pgm else None
+    print(f"Serving frames on :{args.port}/frame")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()